@@ -37,7 +37,7 @@ void append(Array* array, void* value) {
 
 void* unappend(Array* array) {
     assert(array->length > 0);
-    return array->elements[array->length--];
+    return array->elements[--array->length];
 }
 
 void* elementAt(const Array* array, size_t index) {
@@ -1,11 +1,32 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include "util.h"
 #include "pool.h"
 #include "freelist.h"
 
-// NEXT is a pointer to a linked list of unallocated slots, where the elements
-// of the linked list are stored in the slots themselves and contain no data
-static void* NEXT = NULL;
+// each size class has a pool of equally sized slots and a linked list of
+// unallocated slots, where the elements of the linked list are stored in the
+// slots themselves and contain no data. the list ends at the pool itself,
+// which means that the next slot has to be acquired from the pool. slots
+// are held from the time they are acquired until their page is released
+typedef struct {
+    void* next;
+    Pool* pool;
+    size_t size, count, held, peak;
+    size_t threshold;   // count below which pages are worth releasing
+} SizeClass;
+
+// class i holds slots of (i + 1) words, so every slot can hold a link, and
+// nodes get a class of their own at a fixed address for the fast path
+#define CLASS_COUNT 32
+static SizeClass CLASSES[CLASS_COUNT + 1];
+#define NODES (&CLASSES[CLASS_COUNT])
+#define SIZED_CAPACITY ((size_t)1 << 24)   // slots in each of the other classes
+static size_t HEAP_SIZE = 0;        // bytes held by all classes
+size_t MEMORY_LIMIT = (size_t)-1;
+void (*MEMORY_LIMIT_HANDLER)(void) = NULL;
 
 // Note: uncomment marker-related code to help detect premature reclaims.
 // we can keep a marker in every allocated slot before the stored data so that
@@ -13,42 +34,137 @@ static void* NEXT = NULL;
 // to very confusing behavior
 //void* MARKER = (void*)(0xDEFACED);
 
-static Pool* POOL = NULL;
-static size_t SIZE = 0;
-static size_t COUNT = 0;
+static void openSizeClass(SizeClass* sizeClass, size_t size,
+        size_t pageCapacity, size_t capacity, size_t sixteenths,
+        bool hugePages) {
+    // a class never needs more slots than the memory limit allows, and it
+    // only reserves its share of the address space, which is most of it for
+    // nodes and a little for each of the other classes, which are small
+    size_t share = getAddressLimit() / 16 * sixteenths;
+    size_t limit = MEMORY_LIMIT < share ? MEMORY_LIMIT : share;
+    if (limit / size < capacity)
+        capacity = limit / size + pageCapacity;
+    sizeClass->size = size;
+    sizeClass->next = sizeClass->pool =
+        newPool(size, pageCapacity, capacity, hugePages);
+}
 
-void initPool(size_t itemSize, size_t initialCapacity) {
-    assert(POOL == NULL);
-    //SIZE = sizeof(void*) + itemSize;  // for marker
-    SIZE = itemSize;
-    NEXT = POOL = newPool(SIZE, initialCapacity);
+static SizeClass* getSizeClass(size_t size) {
+    size_t i = size == 0 ? 0 : (size - 1) / sizeof(void*);
+    assert(i < CLASS_COUNT);
+    if (CLASSES[i].pool == NULL)
+        openSizeClass(&CLASSES[i], (i + 1) * sizeof(void*), 1024,
+            SIZED_CAPACITY, 1, false);
+    return &CLASSES[i];
 }
 
-void destroyPool(void) {deletePool(POOL);}
-size_t getMemoryUsage(void) {return COUNT * SIZE;}
+void initPool(size_t itemSize, size_t pageCapacity, size_t capacity,
+        bool hugePages) {
+    assert(NODES->pool == NULL && itemSize % sizeof(void*) == 0);
+    //itemSize = sizeof(void*) + itemSize;  // for marker
+    openSizeClass(NODES, itemSize, pageCapacity, capacity, 12, hugePages);
+}
+
+void destroyPool(void) {
+    for (size_t i = 0; i <= CLASS_COUNT; ++i) {
+        if (CLASSES[i].pool != NULL)
+            deletePool(CLASSES[i].pool);
+        CLASSES[i] = (SizeClass){NULL, NULL, 0, 0, 0, 0, 0};
+    }
+    HEAP_SIZE = 0;
+}
+
+size_t getMemoryUsage(void) {
+    size_t usage = 0;
+    for (size_t i = 0; i <= CLASS_COUNT; ++i)
+        usage += CLASSES[i].count * CLASSES[i].size;
+    return usage;
+}
+
+void printMemoryUsage(FILE* stream) {
+    for (size_t i = 0; i <= CLASS_COUNT; ++i) {
+        if (CLASSES[i].pool == NULL)
+            continue;
+        fputs("size ", stream);
+        fputll((long long)CLASSES[i].size, stream);
+        fputs(": ", stream);
+        fputll((long long)CLASSES[i].count, stream);
+        fputs(" live, ", stream);
+        fputll((long long)CLASSES[i].held, stream);
+        fputs(" held, ", stream);
+        fputll((long long)CLASSES[i].peak, stream);
+        fputs(" peak\n", stream);
+    }
+}
 
 //void* mark(void* slot) {
 //    *(void**)slot = MARKER;
 //    return &(((void**)slot)[1]);
 //}
 
-void* allocate(void) {
-    COUNT += 1;
-    if (NEXT == POOL)
-        return acquire(POOL);  //mark(acquire(POOL));
-    void* head = NEXT;
-    NEXT = *(void**)NEXT;
+static void* takeSlot(SizeClass* sizeClass) {
+    void* head = sizeClass->next;
+    sizeClass->next = *(void**)head;
     return head;  //mark(head);
 }
 
+static void* acquireSlot(SizeClass* sizeClass) {
+    if (HEAP_SIZE + sizeClass->size > MEMORY_LIMIT) {
+        // the handler may free memory and return, and then the allocation
+        // is retried before giving up
+        if (MEMORY_LIMIT_HANDLER != NULL)
+            MEMORY_LIMIT_HANDLER();
+        if (sizeClass->next != sizeClass->pool)
+            return takeSlot(sizeClass);
+        if (HEAP_SIZE + sizeClass->size > MEMORY_LIMIT)
+            error("\nError: memory limit exceeded\n");
+    }
+    // all held slots are in use, so this is the only place the peak can grow
+    sizeClass->held += 1;
+    if (sizeClass->held > sizeClass->peak)
+        sizeClass->peak = sizeClass->held;
+    sizeClass->threshold = sizeClass->held / 2;
+    HEAP_SIZE += sizeClass->size;
+    return acquire(sizeClass->pool);  //mark(acquire(sizeClass->pool));
+}
+
+static void* allocateFrom(SizeClass* sizeClass) {
+    sizeClass->count += 1;
+    if (sizeClass->next == sizeClass->pool)
+        return acquireSlot(sizeClass);
+    return takeSlot(sizeClass);
+}
+
 //void* unmark(void* allocated) {
 //    assert(((void**)allocated)[-1] == MARKER);  // detect double reclaim
 //    return &(((void**)allocated)[-1]);
 //}
 
-void reclaim(void* allocated) {
-    COUNT -= 1;
-    void* tail = NEXT;
-    NEXT = allocated;  //unmark(allocated);
-    *(void**)NEXT = tail;
+static void reclaimTo(SizeClass* sizeClass, void* allocated) {
+    sizeClass->count -= 1;
+    void* tail = sizeClass->next;
+    sizeClass->next = allocated;  //unmark(allocated);
+    *(void**)allocated = tail;
+}
+
+void releaseFreePages(void) {
+    // only look for free pages when at least half of the held slots are free,
+    // and then not again until the count halves or the class grows
+    for (size_t i = 0; i <= CLASS_COUNT; ++i) {
+        SizeClass* sizeClass = &CLASSES[i];
+        if (sizeClass->count < sizeClass->threshold) {
+            size_t released = releasePages(sizeClass->pool, &sizeClass->next);
+            sizeClass->held -= released;
+            HEAP_SIZE -= released * sizeClass->size;
+            sizeClass->threshold = sizeClass->count / 2;
+        }
+    }
+}
+
+void* allocate(void) {return allocateFrom(NODES);}
+void reclaim(void* allocated) {reclaimTo(NODES, allocated);}
+
+void* allocateSized(size_t size) {return allocateFrom(getSizeClass(size));}
+void reclaimSized(void* allocated, size_t size) {
+    reclaimTo(getSizeClass(size), allocated);
 }
@@ -1,5 +1,16 @@
-void initPool(size_t itemSize, size_t initialCapacity);
+#include <stdbool.h>
+// slots are pooled in size classes, and nodes have the fast path
+// the handler is called when the heap would exceed the limit, and it can
+// either fail or free memory and return so that the allocation is retried
+extern size_t MEMORY_LIMIT;
+extern void (*MEMORY_LIMIT_HANDLER)(void);
+void initPool(size_t itemSize, size_t pageCapacity, size_t capacity,
+    bool hugePages);
 void destroyPool(void);
 void* allocate(void);
 void reclaim(void* element);
+void* allocateSized(size_t size);
+void reclaimSized(void* element, size_t size);
 size_t getMemoryUsage(void);
+void releaseFreePages(void);
+void printMemoryUsage(FILE* stream);
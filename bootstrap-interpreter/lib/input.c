@@ -0,0 +1,86 @@
+#define _DEFAULT_SOURCE  // madvise, MADV_SEQUENTIAL, MADV_DONTNEED
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdio.h>      // EOF
+#include "input.h"
+
+// standard input is read in blocks instead of a byte at a time. a regular
+// file is mapped and read in place, a window at a time so that the pages
+// that were read can be dropped. anything else is read as it arrives, so a
+// terminal still delivers each line as soon as it is entered
+#define BLOCK_SIZE 65536
+#define WINDOW_SIZE 1048576     // a multiple of the page size
+
+static unsigned char BLOCK[BLOCK_SIZE];
+static const unsigned char* BUFFER = BLOCK;
+static size_t POSITION = 0, LENGTH = 0;
+static unsigned char* MAPPING = NULL;
+static size_t MAPPING_SIZE = 0;
+static bool STARTED = false;
+
+static size_t min(size_t a, size_t b) {return a < b ? a : b;}
+
+static bool mapInput(void) {
+    struct stat status;
+    if (fstat(STDIN_FILENO, &status) != 0 || !S_ISREG(status.st_mode))
+        return false;
+    off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (offset < 0 || offset >= status.st_size)
+        return false;
+    size_t size = (size_t)status.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+    if (mapping == MAP_FAILED)
+        return false;
+    // reads continue after the mapping if the file grows
+    if (lseek(STDIN_FILENO, status.st_size, SEEK_SET) < 0) {
+        munmap(mapping, size);
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    BUFFER = MAPPING = (unsigned char*)mapping;
+    MAPPING_SIZE = size;
+    POSITION = (size_t)offset;
+    LENGTH = min(size, (POSITION / WINDOW_SIZE + 1) * WINDOW_SIZE);
+    return true;
+}
+
+static bool fillBuffer(void) {
+    if (!STARTED) {
+        STARTED = true;
+        if (mapInput())
+            return true;
+    }
+    if (MAPPING != NULL) {
+        if (LENGTH < MAPPING_SIZE) {
+            madvise(&MAPPING[LENGTH - WINDOW_SIZE], WINDOW_SIZE,
+                MADV_DONTNEED);
+            LENGTH = min(MAPPING_SIZE, LENGTH + WINDOW_SIZE);
+            return true;
+        }
+        closeInput();
+    }
+    ssize_t bytes = read(STDIN_FILENO, BLOCK, BLOCK_SIZE);
+    POSITION = 0;
+    LENGTH = bytes > 0 ? (size_t)bytes : 0;
+    return LENGTH > 0;
+}
+
+int readInput(void) {
+    if (POSITION == LENGTH && !fillBuffer())
+        return EOF;
+    return BUFFER[POSITION++];
+}
+
+bool isInputReady(void) {
+    return POSITION < LENGTH || (MAPPING != NULL && LENGTH < MAPPING_SIZE);
+}
+
+void closeInput(void) {
+    if (MAPPING != NULL)
+        munmap(MAPPING, MAPPING_SIZE);
+    BUFFER = BLOCK;
+    MAPPING = NULL;
+    MAPPING_SIZE = POSITION = LENGTH = 0;
+}
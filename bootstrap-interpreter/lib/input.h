@@ -0,0 +1,4 @@
+// reads standard input a byte at a time from a buffer or a mapped file
+int readInput(void);
+bool isInputReady(void);
+void closeInput(void);
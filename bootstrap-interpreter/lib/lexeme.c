@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include "util.h"   // fputll
 #include "lexeme.h"
@@ -23,6 +24,9 @@ unsigned short newFilename(const char* filename) {
     return FILE_COUNT;
 }
 
+unsigned short getFileCount(void) {return FILE_COUNT;}
+const char* getFilename(unsigned short file) {return FILENAMES[file];}
+
 Location newLocation(unsigned short file,
         unsigned short line, unsigned short column) {
     return (Location){.file=file, .line=line, .column=column};
@@ -40,6 +44,60 @@ bool isSameLexeme(Lexeme a, Lexeme b) {
         (a.length == 0 || strncmp(a.start, b.start, a.length) == 0);
 }
 
+// lexemes are interned as symbols by keeping the first lexeme with each
+// text, so interned lexemes with the same text have the same start and can
+// be compared without looking at the text
+static Lexeme* SYMBOLS = NULL;
+static size_t SYMBOL_COUNT = 0, SYMBOL_CAPACITY = 0;
+
+static size_t hashLexeme(Lexeme lexeme) {
+    size_t hash = 2166136261u;
+    for (unsigned short i = 0; i < lexeme.length; ++i)
+        hash = (hash ^ (unsigned char)lexeme.start[i]) * 16777619u;
+    return hash & (SYMBOL_CAPACITY - 1);
+}
+
+static Lexeme* findSymbol(Lexeme lexeme) {
+    size_t i = hashLexeme(lexeme);
+    while (SYMBOLS[i].start != NULL && !isSameLexeme(SYMBOLS[i], lexeme))
+        i = (i + 1) & (SYMBOL_CAPACITY - 1);
+    return &SYMBOLS[i];
+}
+
+static void resizeSymbols(size_t capacity) {
+    Lexeme* symbols = SYMBOLS;
+    size_t oldCapacity = SYMBOL_CAPACITY;
+    SYMBOLS = (Lexeme*)calloc(capacity, sizeof(Lexeme));
+    if (SYMBOLS == NULL)
+        error("\nError: out of memory\n");
+    SYMBOL_CAPACITY = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i)
+        if (symbols[i].start != NULL)
+            *findSymbol(symbols[i]) = symbols[i];
+    free(symbols);
+}
+
+Lexeme internLexeme(Lexeme lexeme) {
+    if (2 * (SYMBOL_COUNT + 1) > SYMBOL_CAPACITY)
+        resizeSymbols(SYMBOL_CAPACITY == 0 ? 1024 : 2 * SYMBOL_CAPACITY);
+    Lexeme* symbol = findSymbol(lexeme);
+    if (symbol->start == NULL) {
+        *symbol = lexeme;
+        SYMBOL_COUNT += 1;
+    }
+    return newLexeme(symbol->start, lexeme.length, lexeme.location);
+}
+
+bool isSameSymbol(Lexeme a, Lexeme b) {
+    return a.start == b.start && a.length == b.length;
+}
+
+void deleteSymbols(void) {
+    free(SYMBOLS);
+    SYMBOLS = NULL;
+    SYMBOL_COUNT = SYMBOL_CAPACITY = 0;
+}
+
 static void printLine(const char* line, FILE* stream) {
     size_t length = 0;
     for (; line[length] != '\0' && line[length] != '\n'; ++length);
@@ -19,8 +19,13 @@ extern const Lexeme EMPTY;
 Lexeme newLexeme(const char* start, unsigned short length, Location location);
 Lexeme newLiteralLexeme(const char* start, Location location);
 unsigned short newFilename(const char* filename);
+unsigned short getFileCount(void);
+const char* getFilename(unsigned short file);
 Location newLocation(unsigned short file,
     unsigned short line, unsigned short column);
 bool isThisLexeme(Lexeme a, const char* b);
 bool isSameLexeme(Lexeme a, Lexeme b);
+Lexeme internLexeme(Lexeme lexeme);
+bool isSameSymbol(Lexeme a, Lexeme b);  // for interned lexemes
+void deleteSymbols(void);
 void printLocation(Location location, FILE* stream);
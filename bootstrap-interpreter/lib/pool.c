@@ -1,33 +1,135 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS, MAP_NORESERVE, MADV_DONTNEED
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>     // sysconf
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include "util.h"
 #include "array.h"
 #include "pool.h"
 
+// each pool reserves address space up front and carves its pages out of the
+// reservation in order, so the page of an item follows from its address.
+// compact builds also use this to refer to items by 32-bit index from the
+// start of the reservation. the reservation is inaccessible until pages are
+// carved out of it, so only those pages count as committed memory
 struct Pool {
-    size_t itemSize, pageCapacity, pageUsage;
-    void* currentPage;
-    Array* pages;
+    size_t itemSize, pageCapacity, pageUsage, reservation;
+    char* base;
+    char* currentPage;
+    char* frontier;     // first page of the reservation that was never used
+    char* committed;    // end of the accessible part of the reservation
+    Array* spares;      // released pages, which are reused first
 };
 
+static size_t getSystemPageSize(void) {
+    return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+size_t getAddressLimit(void) {
+    // the address space limit, or half of a 32-bit address space
+    struct rlimit limit;
+    size_t maximum = sizeof(void*) > 4 ? (size_t)-1 : (size_t)1 << 31;
+    if (getrlimit(RLIMIT_AS, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+            limit.rlim_cur < maximum)
+        maximum = (size_t)limit.rlim_cur;
+    return maximum;
+}
+
+static size_t getReservation(const Pool* pool) {return pool->reservation;}
+
+static size_t getPageSize(const Pool* pool) {
+    return pool->pageCapacity * pool->itemSize;
+}
+
+static char* getPage(const Pool* pool, size_t index) {
+    return pool->base + index * getPageSize(pool);
+}
+
+static size_t findPage(const Pool* pool, void* item) {
+    return (size_t)((char*)item - pool->base) / getPageSize(pool);
+}
+
+static char* newPage(Pool* pool) {
+    if (length(pool->spares) > 0)
+        return unappend(pool->spares);
+    char* page = pool->frontier;
+    if (getPageSize(pool) >
+            (size_t)(pool->base + getReservation(pool) - page))
+        error("\nError: out of memory\n");
+    pool->frontier = page + getPageSize(pool);
+    if (pool->frontier > pool->committed) {
+        // commit whole system pages, at least a megabyte at a time
+        size_t systemPageSize = getSystemPageSize();
+        size_t size = (size_t)(pool->frontier - pool->committed);
+        size = size > 1 << 20 ? size : 1 << 20;
+        size = (size + systemPageSize - 1) / systemPageSize * systemPageSize;
+        size_t rest = (size_t)(pool->base + getReservation(pool) -
+            pool->committed);
+        size = size < rest ? size : rest;
+        if (mprotect(pool->committed, size, PROT_READ | PROT_WRITE) != 0)
+            error("\nError: out of memory\n");
+        pool->committed += size;
+    }
+    return page;
+}
+
+static void releasePage(Pool* pool, char* page) {
+    // only the system pages that lie entirely within the page are released
+    uintptr_t systemPageSize = (uintptr_t)getSystemPageSize();
+    uintptr_t start = ((uintptr_t)page + systemPageSize - 1) / systemPageSize;
+    uintptr_t end = ((uintptr_t)page + getPageSize(pool)) / systemPageSize;
+    if (start < end)
+        madvise((void*)(start * systemPageSize),
+            (end - start) * systemPageSize, MADV_DONTNEED);
+    append(pool->spares, page);
+}
+
 static void appendPage(Pool* pool) {
-    pool->currentPage = smalloc(pool->pageCapacity * pool->itemSize);
-    append(pool->pages, pool->currentPage);
+    pool->currentPage = newPage(pool);
     pool->pageUsage = 0;
 }
 
-Pool* newPool(size_t itemSize, size_t pageCapacity) {
+static void* reserve(Pool* pool, size_t capacity) {
+    // reserves as many whole pages as the capacity holds, halving the
+    // reservation until it fits in the address space
+    size_t pageSize = getPageSize(pool);
+    for (size_t pages = capacity / pool->pageCapacity; pages > 0; pages /= 2) {
+        void* base = mmap(NULL, pages * pageSize, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base != MAP_FAILED) {
+            pool->reservation = pages * pageSize;
+            return base;
+        }
+    }
+    return error("\nError: out of memory\n");
+}
+
+Pool* newPool(size_t itemSize, size_t pageCapacity, size_t capacity,
+        bool hugePages) {
+    // the pool holds at most the capacity in items, rounded down to pages
     Pool* pool = (Pool*)smalloc(sizeof(Pool));
     pool->itemSize = itemSize;
     pool->pageCapacity = pageCapacity;
-    pool->pages = newArray(32);
+    void* base = reserve(pool, capacity);
+#ifdef MADV_HUGEPAGE
+    // transparent huge pages reduce TLB misses, but free pages are then
+    // only returned once the kernel splits the huge pages they lie in
+    if (hugePages)
+        madvise(base, getReservation(pool), MADV_HUGEPAGE);
+#else
+    (void)hugePages;
+#endif
+    pool->base = pool->frontier = pool->committed = (char*)base;
+    pool->spares = newArray(32);
     appendPage(pool);
     return pool;
 }
 
 void deletePool(Pool* pool) {
-    for (size_t i = 0; i < length(pool->pages); ++i)
-        free(elementAt(pool->pages, i));
-    deleteArray(pool->pages);
+    munmap(pool->base, getReservation(pool));
+    deleteArray(pool->spares);
     free(pool);
 }
 
@@ -37,3 +139,39 @@ void* acquire(Pool* pool) {
     return (void*)(&((char*)(pool->currentPage))
         [pool->itemSize * pool->pageUsage++]);
 }
+
+static bool isFreePage(const Pool* pool, size_t index, size_t freeCount) {
+    return freeCount == pool->pageCapacity &&
+        getPage(pool, index) != pool->currentPage;
+}
+
+size_t releasePages(Pool* pool, void** freeList) {
+    // count the items of each page that are on the free list, which is linked
+    // through the items and ends at the pool, to find the pages that are free
+    size_t count = (size_t)(pool->frontier - pool->base) / getPageSize(pool);
+    size_t* freeCounts = (size_t*)calloc(count, sizeof(size_t));
+    if (freeCounts == NULL)
+        error("\nError: out of memory\n");
+    for (void* item = *freeList; item != pool; item = *(void**)item)
+        freeCounts[findPage(pool, item)] += 1;
+
+    // unlink the items of free pages, then release the pages
+    void** link = freeList;
+    for (void* item = *freeList; item != pool; item = *(void**)item) {
+        size_t i = findPage(pool, item);
+        if (!isFreePage(pool, i, freeCounts[i])) {
+            *link = item;
+            link = (void**)item;
+        }
+    }
+    *link = pool;
+    size_t released = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (isFreePage(pool, i, freeCounts[i])) {
+            releasePage(pool, getPage(pool, i));
+            released += pool->pageCapacity;
+        }
+    }
+    free(freeCounts);
+    return released;
+}
@@ -1,4 +1,7 @@
 typedef struct Pool Pool;
-Pool* newPool(size_t itemSize, size_t pageCapacity);
+Pool* newPool(size_t itemSize, size_t pageCapacity, size_t capacity,
+    bool hugePages);
 void deletePool(Pool* pool);
+size_t getAddressLimit(void);
 void* acquire(Pool* pool);
+size_t releasePages(Pool* pool, void** freeList);
@@ -0,0 +1,214 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include "util.h"
+#include "tree.h"
+#include "profile.h"
+
+// heap profiles attribute each node to a site, which is the reference to the
+// global that was entered most recently by the computation that allocates
+// it, or else the tag of the node. sites are told apart by name and location,
+// and site 0 collects nodes without either
+typedef struct {
+    Lexeme lexeme;
+    unsigned long long live, peak, total;   // in nodes
+} Site;
+
+typedef struct {
+    Tag tag;
+    unsigned int site;
+} Current;
+
+bool PROFILING = false;
+static size_t NODE_SIZE = 0;
+static Site* SITES = NULL;
+static size_t SITE_COUNT = 0, SITE_CAPACITY = 0;
+static unsigned int* KEYS = NULL;           // hash table of site numbers
+static size_t KEY_CAPACITY = 0;
+static unsigned int* SLOTS = NULL;          // site of each node slot
+static size_t SLOT_CAPACITY = 0;
+static Current CURRENT = {NULL, 0};
+static Current* SAVED = NULL;               // sites to restore on return
+static size_t SAVED_COUNT = 0, SAVED_CAPACITY = 0;
+static unsigned long long ALLOCATIONS = 0;
+static const unsigned long long SNAPSHOT_INTERVAL = 1ull << 24;
+static const size_t SNAPSHOT_LENGTH = 10;
+
+static void* resize(void* elements, size_t capacity, size_t size) {
+    elements = realloc(elements, capacity * size);
+    return elements == NULL ? error("\nError: out of memory\n") : elements;
+}
+
+static size_t hashLexeme(Lexeme lexeme) {
+    Location location = lexeme.location;
+    size_t hash = 2166136261u;
+    hash = (hash ^ location.file) * 16777619u;
+    hash = (hash ^ location.line) * 16777619u;
+    hash = (hash ^ location.column) * 16777619u;
+    for (unsigned short i = 0; i < lexeme.length; ++i)
+        hash = (hash ^ (unsigned char)lexeme.start[i]) * 16777619u;
+    return hash & (KEY_CAPACITY - 1);
+}
+
+static bool isSameSite(Lexeme a, Lexeme b) {
+    return a.location.file == b.location.file &&
+        a.location.line == b.location.line &&
+        a.location.column == b.location.column && isSameLexeme(a, b);
+}
+
+static unsigned int* findKey(Lexeme lexeme) {
+    size_t i = hashLexeme(lexeme);
+    while (KEYS[i] != 0 && !isSameSite(SITES[KEYS[i]].lexeme, lexeme))
+        i = (i + 1) & (KEY_CAPACITY - 1);
+    return &KEYS[i];
+}
+
+static void resizeKeys(size_t capacity) {
+    free(KEYS);
+    KEYS = (unsigned int*)calloc(capacity, sizeof(unsigned int));
+    if (KEYS == NULL)
+        error("\nError: out of memory\n");
+    KEY_CAPACITY = capacity;
+    for (unsigned int site = 1; site < SITE_COUNT; ++site)
+        *findKey(SITES[site].lexeme) = site;
+}
+
+static unsigned int addSite(Lexeme lexeme) {
+    if (SITE_COUNT == SITE_CAPACITY) {
+        SITE_CAPACITY = 2 * SITE_CAPACITY;
+        SITES = (Site*)resize(SITES, SITE_CAPACITY, sizeof(Site));
+    }
+    SITES[SITE_COUNT] = (Site){lexeme, 0, 0, 0};
+    return (unsigned int)SITE_COUNT++;
+}
+
+static unsigned int getSite(Tag tag) {
+    if (tag == NULL)
+        return 0;
+    Lexeme lexeme = getLexeme(tag);
+    unsigned int* key = findKey(lexeme);
+    if (*key != 0)
+        return *key;
+    *key = addSite(lexeme);
+    if (2 * SITE_COUNT > KEY_CAPACITY)
+        resizeKeys(2 * KEY_CAPACITY);
+    return (unsigned int)(SITE_COUNT - 1);
+}
+
+void initProfile(size_t nodeSize) {
+    NODE_SIZE = nodeSize;
+    SITE_CAPACITY = 1024;
+    SITES = (Site*)resize(NULL, SITE_CAPACITY, sizeof(Site));
+    addSite(EMPTY);
+    resizeKeys(2048);
+}
+
+void deleteProfile(void) {
+    free(SITES);
+    free(KEYS);
+    free(SLOTS);
+    free(SAVED);
+    SITES = NULL;
+    KEYS = SLOTS = NULL;
+    SAVED = NULL;
+    SITE_COUNT = SITE_CAPACITY = KEY_CAPACITY = SLOT_CAPACITY = 0;
+    SAVED_COUNT = SAVED_CAPACITY = 0;
+    CURRENT = (Current){NULL, 0};
+    ALLOCATIONS = 0;
+}
+
+void enterSite(Tag tag) {
+    if (tag != CURRENT.tag)
+        CURRENT = (Current){tag, getSite(tag)};
+}
+
+void saveSite(void) {
+    // called when the evaluator defers to a computation whose value it will
+    // return to, so that the allocations after the return go to the caller
+    if (SAVED_COUNT == SAVED_CAPACITY) {
+        SAVED_CAPACITY = SAVED_CAPACITY == 0 ? 1024 : 2 * SAVED_CAPACITY;
+        SAVED = (Current*)resize(SAVED, SAVED_CAPACITY, sizeof(Current));
+    }
+    SAVED[SAVED_COUNT++] = CURRENT;
+}
+
+void restoreSite(void) {
+    assert(SAVED_COUNT > 0);
+    CURRENT = SAVED[--SAVED_COUNT];
+}
+
+static void printSite(const Site* site, FILE* stream) {
+    fputll((long long)(site->live * NODE_SIZE), stream);
+    fputs("\t", stream);
+    fputll((long long)(site->peak * NODE_SIZE), stream);
+    fputs("\t", stream);
+    fputll((long long)(site->total * NODE_SIZE), stream);
+    fputs("\t", stream);
+    if (site == SITES) {
+        fputs("(unknown)\n", stream);
+        return;
+    }
+    if (site->lexeme.length > 0 && site->lexeme.start[0] == '\n') {
+        fputs("(end of line)\n", stream);
+        return;
+    }
+    fputs("'", stream);
+    fwrite(site->lexeme.start, sizeof(char), site->lexeme.length, stream);
+    fputs("' at ", stream);
+    printLocation(site->lexeme.location, stream);
+    fputs("\n", stream);
+}
+
+static int compareLive(const void* a, const void* b) {
+    const Site *x = *(const Site* const*)a, *y = *(const Site* const*)b;
+    return (x->live < y->live) - (x->live > y->live);
+}
+
+static int compareTotal(const void* a, const void* b) {
+    const Site *x = *(const Site* const*)a, *y = *(const Site* const*)b;
+    return (x->total < y->total) - (x->total > y->total);
+}
+
+static void printSites(size_t limit, int (*compare)(const void*, const void*),
+        FILE* stream) {
+    const Site** sites = (const Site**)resize(NULL, SITE_COUNT, sizeof(Site*));
+    for (size_t i = 0; i < SITE_COUNT; ++i)
+        sites[i] = &SITES[i];
+    qsort(sites, SITE_COUNT, sizeof(Site*), compare);
+    fputs("live bytes\tpeak bytes\ttotal bytes\tsite\n", stream);
+    for (size_t i = 0; i < SITE_COUNT && i < limit; ++i)
+        if (sites[i]->total > 0)
+            printSite(sites[i], stream);
+    free(sites);
+}
+
+static void printSnapshot(FILE* stream) {
+    fputs("\nheap snapshot after ", stream);
+    fputll((long long)ALLOCATIONS, stream);
+    fputs(" allocations\n", stream);
+    printSites(SNAPSHOT_LENGTH, compareLive, stream);
+}
+
+void reportProfile(FILE* stream) {
+    fputs("\nheap profile after ", stream);
+    fputll((long long)ALLOCATIONS, stream);
+    fputs(" allocations\n", stream);
+    printSites(SITE_COUNT, compareTotal, stream);
+}
+
+void profileAllocation(size_t slot, Tag tag) {
+    if (slot >= SLOT_CAPACITY) {
+        SLOT_CAPACITY = 2 * slot + 1;
+        SLOTS = (unsigned int*)resize(SLOTS, SLOT_CAPACITY,
+            sizeof(unsigned int));
+    }
+    SLOTS[slot] = CURRENT.tag != NULL ? CURRENT.site : getSite(tag);
+    Site* site = &SITES[SLOTS[slot]];
+    site->live += 1;
+    site->total += 1;
+    if (site->live > site->peak)
+        site->peak = site->live;
+    if (++ALLOCATIONS % SNAPSHOT_INTERVAL == 0)
+        printSnapshot(stderr);
+}
+
+void profileRelease(size_t slot) {SITES[SLOTS[slot]].live -= 1;}
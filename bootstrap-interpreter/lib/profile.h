@@ -0,0 +1,17 @@
+// the hooks cost a few percent on every allocation even when profiling is off,
+// so they are only compiled into profile builds
+#ifdef PROFILE
+#define PROFILED(statement) do {if (PROFILING) {statement;}} while (false)
+#else
+#define PROFILED(statement) do {} while (false)
+#endif
+
+extern bool PROFILING;
+void initProfile(size_t nodeSize);
+void deleteProfile(void);
+void enterSite(Tag tag);
+void saveSite(void);
+void restoreSite(void);
+void profileAllocation(size_t slot, Tag tag);
+void profileRelease(size_t slot);
+void reportProfile(FILE* stream);
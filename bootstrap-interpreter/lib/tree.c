@@ -1,12 +1,239 @@
+#ifdef LATENCY
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+#include <time.h>
+#endif
 #include <assert.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdlib.h>  // exit
+#include <stdint.h>  // uintptr_t
+#include <limits.h>  // CHAR_BIT
 #include <string.h>
+#include "util.h"
 #include "freelist.h"
 #include "tree.h"
+#include "profile.h"
 
-typedef enum {GC_NONE=0, GC_LEFT=1, GC_RIGHT=2, GC_BOTH=3} Flags;
+typedef enum {GC_NONE=0, GC_LEFT=1, GC_RIGHT=2, GC_BOTH=3, TAGGED=4,
+    LEXEME=8} Flags;
+
+// immediates are small untagged leaves stored in the node pointer itself as
+// (value << 8 | type << 1 | 1), which is never a valid node pointer since
+// nodes are aligned, so they need no allocation or reference counting.
+// they are only enabled with -DIMMEDIATE because checking for them on every
+// reference count update costs more than they save on our benchmarks
+#ifdef IMMEDIATE
+static bool isImmediate(const Node* node) {return (uintptr_t)node & 1;}
+#else
+static bool isImmediate(const Node* node) {(void)node; return false;}
+#endif
+static char getImmediateType(const Node* node) {
+    return (char)(((uintptr_t)node >> 1) & 0x7f);
+}
+static long long getImmediateValue(const Node* node) {
+    return (long long)((uintptr_t)node >> 8);
+}
+
+// latency builds keep a histogram of the time spent in each allocation and
+// release, in power-of-two buckets of nanoseconds, and print it on exit when
+// asked, since the test suites compare everything written to stderr
+bool TIMING = false;
+
+#ifdef LATENCY
+static unsigned long long LATENCIES[64];
+
+static long long getTime(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (long long)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static void recordLatency(long long start) {
+    long long elapsed = getTime() - start;
+    int bucket = 0;
+    while (bucket < 63 && elapsed >= 1LL << bucket)
+        ++bucket;
+    LATENCIES[bucket] += 1;
+}
+
+static void reportLatencies(void) {
+    if (!TIMING)
+        return;
+    fputs("latency (ns)\tcount\n", stderr);
+    for (int i = 0; i < 64; ++i) {
+        if (LATENCIES[i] == 0)
+            continue;
+        fputs("< ", stderr);
+        fputll(1LL << i, stderr);
+        fputs("\t", stderr);
+        fputll((long long)LATENCIES[i], stderr);
+        fputs("\n", stderr);
+    }
+}
+#define TIMED(statement) \
+    do {long long start = getTime(); statement; recordLatency(start);} \
+    while (false)
+#else
+static void reportLatencies(void) {}
+#define TIMED(statement) statement
+#endif
+
+// compact nodes and heap profiles refer to nodes by their offset from the
+// first slot acquired from the pool, which is the start of its reservation
+static Node* BASE = NULL;
+
+static void initBase(void) {
+    BASE = (Node*)allocate();
+    reclaim(BASE);
+}
+
+static void finishProfile(void) {
+    if (PROFILING) {
+        reportProfile(stderr);
+        deleteProfile();
+    }
+}
+
+#ifdef COMPACT
+
+// compact nodes are 16 bytes: children are 32-bit indexes into the node pool,
+// which is a single reservation of address space, and tags are kept in a side
+// table since most nodes created during evaluation are closures without tags
+typedef unsigned int Index;
+// an index is one more than the offset, shifted past the immediate bit, so
+// the pool is capped at the nodes that an index can reach
+#define NODE_CAPACITY (((size_t)1 << 31) - 1)
+
+struct Node {
+    unsigned int referenceCount;
+    char flags, type, variety;
+    union {
+        struct {Index left, right;} branches;
+        void* pointer;
+        long long value;
+    } data;
+};
+
+typedef struct {Index key, tag;} TagEntry;
+
+static TagEntry* TAGS = NULL;
+static size_t TAG_CAPACITY = 0, TAG_COUNT = 0;
+
+// even indexes refer to nodes in the pool and odd indexes are immediates
+static Node* toNode(Index i) {
+    return i == 0 ? NULL :
+        i & 1 ? (Node*)(uintptr_t)i : &BASE[(i >> 1) - 1];
+}
+
+static Index toIndex(Node* node) {
+    assert(node == NULL || isImmediate(node) ||
+        (size_t)(node - BASE) < NODE_CAPACITY);
+    return node == NULL ? 0 : isImmediate(node) ? (Index)(uintptr_t)node :
+        (Index)((node - BASE) + 1) << 1;
+}
+
+static size_t hashIndex(Index key) {
+    return (size_t)(key * 2654435761u) & (TAG_CAPACITY - 1);
+}
+
+static TagEntry* findTagEntry(Index key) {
+    size_t i = hashIndex(key);
+    while (TAGS[i].key != key && TAGS[i].key != 0)
+        i = (i + 1) & (TAG_CAPACITY - 1);
+    return &TAGS[i];
+}
+
+static void resizeTagTable(size_t capacity) {
+    TagEntry* entries = TAGS;
+    size_t oldCapacity = TAG_CAPACITY;
+    TAGS = (TagEntry*)calloc(capacity, sizeof(TagEntry));
+    if (TAGS == NULL)
+        error("\nError: out of memory\n");
+    TAG_CAPACITY = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i)
+        if (entries[i].key != 0)
+            *findTagEntry(entries[i].key) = entries[i];
+    free(entries);
+}
+
+static void eraseTagEntry(TagEntry* entry) {
+    // backward shift deletion keeps probe sequences intact without tombstones
+    size_t mask = TAG_CAPACITY - 1, i = (size_t)(entry - TAGS), j = i;
+    for (j = (j + 1) & mask; TAGS[j].key != 0; j = (j + 1) & mask) {
+        size_t k = hashIndex(TAGS[j].key);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        TAGS[i] = TAGS[j];
+        i = j;
+    }
+    TAGS[i].key = 0;
+    TAG_COUNT -= 1;
+}
+
+void initNodeAllocator(size_t pageCapacity, bool hugePages) {
+    initPool(sizeof(Node), pageCapacity, NODE_CAPACITY, hugePages);
+    initBase();
+    resizeTagTable(4096);
+    if (PROFILING)
+        initProfile(sizeof(Node));
+}
+
+void destroyNodeAllocator(void) {
+    reportLatencies();
+    finishProfile();
+    destroyPool();
+    free(TAGS);
+    TAGS = NULL;
+    TAG_CAPACITY = TAG_COUNT = 0;
+}
+
+Tag getTag(Node* node) {
+    return isImmediate(node) || !(node->flags & TAGGED) ? NULL :
+        (Tag)toNode(findTagEntry(toIndex(node))->tag);
+}
+
+static void storeTag(Node* node, Tag tag) {
+    if (node->flags & TAGGED) {
+        TagEntry* entry = findTagEntry(toIndex(node));
+        if (tag != NULL) {
+            entry->tag = toIndex((Node*)tag);
+            return;
+        }
+        eraseTagEntry(entry);
+        node->flags &= ~TAGGED;
+    } else if (tag != NULL) {
+        if (2 * (TAG_COUNT + 1) > TAG_CAPACITY)
+            resizeTagTable(2 * TAG_CAPACITY);
+        *findTagEntry(toIndex(node)) =
+            (TagEntry){toIndex(node), toIndex((Node*)tag)};
+        TAG_COUNT += 1;
+        node->flags |= TAGGED;
+    }
+}
+
+Node* getLeft(Node* node) {return toNode(node->data.branches.left);}
+Node* getRight(Node* node) {return toNode(node->data.branches.right);}
+static void storeLeft(Node* node, Node* left) {
+    node->data.branches.left = toIndex(left);
+}
+static void storeRight(Node* node, Node* right) {
+    node->data.branches.right = toIndex(right);
+}
+static Lexeme* getLexemeSlot(Node* tag) {return (Lexeme*)tag->data.pointer;}
+
+// the reference count of a released node links it into the dead list
+static Node* getLink(Node* node) {return toNode(node->referenceCount);}
+static void storeLink(Node* node, Node* link) {
+    node->referenceCount = toIndex(link);
+}
+
+static Lexeme* newLexemeSlot(Node* tag) {
+    // the lexeme doesn't fit in a compact node so it gets a slot of its own
+    tag->flags |= LEXEME;
+    return (Lexeme*)(tag->data.pointer = allocateSized(sizeof(Lexeme)));
+}
+
+#else
 
 struct Node {
     unsigned int referenceCount;
@@ -20,29 +247,222 @@ struct Node {
     } data;
 };
 
-void initNodeAllocator(void) {initPool(sizeof(Node), 4096);}
-void destroyNodeAllocator(void) {destroyPool();}
-Tag getTag(Node* node) {return node->tag;}
-char getType(Node* node) {return node->type;}
-void setType(Node* node, char type) {node->type = type;}
-char getVariety(Node* node) {return node->variety;}
-void setVariety(Node* node, char variety) {node->variety = variety;}
+typedef uintptr_t Index;  // width of a child reference
+#define NODE_CAPACITY ((size_t)1 << 31)
+
+void initNodeAllocator(size_t pageCapacity, bool hugePages) {
+    initPool(sizeof(Node), pageCapacity, NODE_CAPACITY, hugePages);
+    initBase();
+    if (PROFILING)
+        initProfile(sizeof(Node));
+}
+
+void destroyNodeAllocator(void) {
+    reportLatencies();
+    finishProfile();
+    destroyPool();
+}
+Tag getTag(Node* node) {return isImmediate(node) ? NULL : node->tag;}
+static void storeTag(Node* node, Tag tag) {node->tag = tag;}
 Node* getLeft(Node* node) {return node->data.branches.left;}
 Node* getRight(Node* node) {return node->data.branches.right;}
-long long getValue(Node* node) {return node->data.value;}
+static void storeLeft(Node* node, Node* left) {node->data.branches.left = left;}
+static void storeRight(Node* node, Node* right) {
+    node->data.branches.right = right;
+}
+static Lexeme* getLexemeSlot(Node* tag) {return &tag->data.lexeme;}
+
+// the tag of a released node links it into the dead list
+static Node* getLink(Node* node) {return (Node*)node->tag;}
+static void storeLink(Node* node, Node* link) {node->tag = (Tag)link;}
+
+static Lexeme* newLexemeSlot(Node* tag) {return &tag->data.lexeme;}
+
+#endif
+
+#ifdef PROFILE
+static size_t getSlot(Node* node) {return (size_t)(node - BASE);}
+#endif
+
+bool isBranch(Node* node) {
+    return !isImmediate(node) && (node->flags & GC_BOTH) == GC_BOTH;
+}
+
+char getType(Node* node) {
+    return isImmediate(node) ? getImmediateType(node) : node->type;
+}
+
+void setType(Node* node, char type) {node->type = type;}
+char getVariety(Node* node) {return isImmediate(node) ? 0 : node->variety;}
+void setVariety(Node* node, char variety) {node->variety = variety;}
+long long getValue(Node* node) {
+    return isImmediate(node) ? getImmediateValue(node) : node->data.value;
+}
+
 void setValue(Node* node, long long value) {node->data.value = value;}
 void* getData(Node* node) {return node->data.pointer;}
-static Node* copyNode(Node* node, Node* source) {return *node = *source, node;}
 
 static Node* reference(Node* node) {
-    return node == NULL ? NULL : (node->referenceCount += 1, node);
+    return node == NULL || isImmediate(node) ? node :
+        (node->referenceCount += 1, node);
+}
+
+unsigned int getReferenceCount(Node* node) {
+    return isImmediate(node) ? 1 : node->referenceCount;
+}
+
+// released nodes are kept on a dead list until their slot is reused, which
+// is when their children are released, so that dropping a large structure
+// costs a bounded amount of work per allocation instead of one long pause
+static Node* DEAD = NULL;
+
+static void releaseNode(Node* node) {
+    if (node == NULL || isImmediate(node))
+        return;
+    assert(node->referenceCount > 0);
+    node->referenceCount -= 1;
+    if (node->referenceCount > 0)
+        return;
+    // the tag is released right away since its slot may hold the link
+    Tag tag = getTag(node);
+    if (tag != NULL)
+        storeTag(node, NULL);
+    storeLink(node, DEAD);
+    DEAD = node;
+    PROFILED(profileRelease(getSlot(node)));
+    releaseNode((Node*)tag);
+}
+
+static Node* recycle(void) {
+    Node* node = DEAD;
+    DEAD = getLink(node);
+    if (node->flags & LEXEME)
+        reclaimSized(node->data.pointer, sizeof(Lexeme));
+    if (node->flags & GC_LEFT)
+        releaseNode(getLeft(node));
+    if (node->flags & GC_RIGHT)
+        releaseNode(getRight(node));
+    return node;
+}
+
+void flushReleases(void) {
+    while (DEAD != NULL)
+        reclaim(recycle());
+}
+
+void releaseFreeMemory(void) {
+    flushReleases();
+    releaseFreePages();
+}
+
+#ifdef SHARE
+
+// hash-consing shares one node between identical immutable terms. the table
+// holds a reference to each shared node instead of dropping it on release,
+// since a check on every release costs more, and nodes that only the table
+// refers to are dropped when it fills up
+static Node** SHARED_NODES = NULL;
+static size_t SHARED_CAPACITY = 0, SHARED_COUNT = 0;
+
+// nodes are shared by their tag, type, variety, and value or children, which
+// are compared by identity so sharing a term implies sharing its subterms
+typedef struct {
+    Tag tag;
+    char flags, type, variety;
+    unsigned long long first, second;
+} Shape;
+
+static Shape getShape(Node* node) {
+    bool branch = isBranch(node);
+    return (Shape){getTag(node), node->flags & GC_BOTH, node->type,
+        node->variety, branch ? (uintptr_t)getLeft(node) :
+        (unsigned long long)node->data.value,
+        branch ? (uintptr_t)getRight(node) : 0};
+}
+
+static bool isSameShape(Shape a, Shape b) {
+    return a.tag == b.tag && a.flags == b.flags && a.type == b.type &&
+        a.variety == b.variety && a.first == b.first && a.second == b.second;
+}
+
+static size_t hashShape(Shape shape) {
+    unsigned long long hash = (uintptr_t)shape.tag;
+    hash = (hash ^ (unsigned char)shape.type ^
+        (unsigned)(unsigned char)shape.variety << 8) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ shape.first) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ shape.second) * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 32) & (SHARED_CAPACITY - 1);
+}
+
+static Node** findSharedNode(Shape shape) {
+    size_t i = hashShape(shape);
+    while (SHARED_NODES[i] != NULL &&
+            !isSameShape(getShape(SHARED_NODES[i]), shape))
+        i = (i + 1) & (SHARED_CAPACITY - 1);
+    return &SHARED_NODES[i];
+}
+
+static void resizeSharedNodes(size_t capacity) {
+    // drops the nodes that only the table refers to
+    Node** nodes = SHARED_NODES;
+    size_t oldCapacity = SHARED_CAPACITY;
+    SHARED_NODES = (Node**)calloc(capacity, sizeof(Node*));
+    if (SHARED_NODES == NULL)
+        error("\nError: out of memory\n");
+    SHARED_CAPACITY = capacity;
+    SHARED_COUNT = 0;
+    for (size_t i = 0; i < oldCapacity; ++i) {
+        if (nodes[i] == NULL)
+            continue;
+        if (nodes[i]->referenceCount == 1) {
+            releaseNode(nodes[i]);
+        } else {
+            *findSharedNode(getShape(nodes[i])) = nodes[i];
+            SHARED_COUNT += 1;
+        }
+    }
+    free(nodes);
+}
+
+static Node* share(Node* node) {
+    // the table only grows if at least half of it is still in use
+    if (2 * (SHARED_COUNT + 1) > SHARED_CAPACITY) {
+        resizeSharedNodes(SHARED_CAPACITY == 0 ? 1024 : SHARED_CAPACITY);
+        if (4 * (SHARED_COUNT + 1) > SHARED_CAPACITY)
+            resizeSharedNodes(2 * SHARED_CAPACITY);
+    }
+    *findSharedNode(getShape(node)) = node;
+    SHARED_COUNT += 1;
+    return reference(node);
+}
+
+void releaseSharedNodes(void) {
+    for (size_t i = 0; i < SHARED_CAPACITY; ++i)
+        releaseNode(SHARED_NODES[i]);
+    free(SHARED_NODES);
+    SHARED_NODES = NULL;
+    SHARED_CAPACITY = SHARED_COUNT = 0;
+}
+
+#endif
+
+static Node* newNode(Tag tag, char flags, char type, char variety) {
+    Node* node;
+    TIMED(node = DEAD == NULL ? (Node*)allocate() : recycle());
+    node->referenceCount = 0;
+    node->flags = flags;
+    node->type = type;
+    node->variety = variety;
+    storeTag(node, (Tag)reference((Node*)tag));
+    PROFILED(profileAllocation(getSlot(node), tag));
+    return node;
 }
 
 Node* newBranch(Tag tag, char type, char variety, Node* left, Node* right) {
-    return copyNode((Node*)allocate(), &(Node)
-        {.referenceCount=0, .flags=GC_BOTH, .type=type, .variety=variety,
-        .tag=(Tag)reference((Node*)tag),
-        .data={.branches={.left=reference(left), .right=reference(right)}}});
+    Node* node = newNode(tag, GC_BOTH, type, variety);
+    storeLeft(node, reference(left));
+    storeRight(node, reference(right));
+    return node;
 }
 
 Node* newPair(Node* left, Node* right) {
@@ -50,72 +470,107 @@ Node* newPair(Node* left, Node* right) {
 }
 
 Node* newLeaf(Tag tag, char type, char variety, long long data) {
-    return copyNode((Node*)allocate(), &(Node)
-        {.referenceCount=0, .flags=GC_NONE, .type=type, .variety=variety,
-        .tag=(Tag)reference((Node*)tag), .data={.value=data}});
+    Node* node = newNode(tag, GC_NONE, type, variety);
+    node->data.value = data;
+    return node;
 }
 
-Node* newPointerLeaf(Tag tag, char type, char variety, void* data) {
-    return copyNode((Node*)allocate(), &(Node)
-        {.referenceCount=0, .flags=GC_NONE, .type=type, .variety=variety,
-        .tag=(Tag)reference((Node*)tag), .data={.pointer=data}});
+Node* newUntaggedLeaf(char type, long long data) {
+#ifdef IMMEDIATE
+    // immediates must also fit in a child reference
+    const int bits = sizeof(Index) * CHAR_BIT - 9;
+    if (data >= 0 && data < 1LL << bits && type >= 0)
+        return (Node*)((uintptr_t)data << 8 | (uintptr_t)type << 1 | 1);
+#endif
+    return newLeaf(NULL, type, 0, data);
 }
 
-static void releaseNode(Node* node) {
-    if (node == NULL)
-        return;
-    assert(node->referenceCount > 0);
-    node->referenceCount -= 1;
-    if (node->referenceCount > 0)
-        return;
-    if (node->tag != NULL)
-        releaseNode((Node*)(node->tag));
-    // conserve stack with partial tail recursion to reduce stack segfaults
-    Node* left = node->flags & GC_LEFT ? node->data.branches.left : NULL;
-    Node* right = node->flags & GC_RIGHT ? node->data.branches.right : NULL;
-    reclaim(node);
-    if (left != NULL)
-        releaseNode(left);
-    if (right != NULL)
-        releaseNode(right);
+#ifdef SHARE
+
+static Node* findShared(Tag tag, char flags, char type, char variety,
+        unsigned long long first, unsigned long long second) {
+    return SHARED_CAPACITY == 0 ? NULL : *findSharedNode(
+        (Shape){tag, flags, type, variety, first, second});
+}
+
+Node* newSharedBranch(Tag tag, char type, char variety, Node* left,
+        Node* right) {
+    // children that are new can't be in a shared node yet, so a match means
+    // that they are the children of the shared node and already referenced
+    Node* node = findShared(tag, GC_BOTH, type, variety, (uintptr_t)left,
+        (uintptr_t)right);
+    return node != NULL ? node :
+        share(newBranch(tag, type, variety, left, right));
+}
+
+Node* newSharedLeaf(Tag tag, char type, char variety, long long data) {
+    Node* node = findShared(tag, GC_NONE, type, variety,
+        (unsigned long long)data, 0);
+    return node != NULL ? node : share(newLeaf(tag, type, variety, data));
+}
+
+#else
+
+Node* newSharedBranch(Tag tag, char type, char variety, Node* left,
+        Node* right) {
+    return newBranch(tag, type, variety, left, right);
+}
+
+Node* newSharedLeaf(Tag tag, char type, char variety, long long data) {
+    return newLeaf(tag, type, variety, data);
+}
+
+void releaseSharedNodes(void) {}
+
+#endif
+
+Node* newPointerLeaf(Tag tag, char type, char variety, void* data) {
+    Node* node = newNode(tag, GC_NONE, type, variety);
+    node->data.pointer = data;
+    return node;
 }
 
 void setLeft(Node* node, Node* left) {
     assert(node->flags & GC_LEFT);
-    Node* oldLeft = node->data.branches.left;
-    node->data.branches.left = reference(left);
-    releaseNode(oldLeft);
+    Node* oldLeft = getLeft(node);
+    storeLeft(node, reference(left));
+    TIMED(releaseNode(oldLeft));
 }
 
 void setTag(Node* node, Tag tag) {
-    Tag oldTag = node->tag;
-    node->tag = (Tag)reference((Node*)tag);
-    releaseNode((Node*)oldTag);
+    Tag oldTag = getTag(node);
+    storeTag(node, (Tag)reference((Node*)tag));
+    TIMED(releaseNode((Node*)oldTag));
 }
 
 void setRight(Node* node, Node* right) {
     assert(node->flags & GC_RIGHT);
-    Node* oldRight = node->data.branches.right;
-    node->data.branches.right = reference(right);
-    releaseNode(oldRight);
+    Node* oldRight = getRight(node);
+    storeRight(node, reference(right));
+    TIMED(releaseNode(oldRight));
 }
 
 Hold* hold(Node* node) {return reference(node);}
-void release(Hold* node) {releaseNode(node);}
+void release(Hold* node) {TIMED(releaseNode(node));}
 
 Node* getListElement(Node* node, unsigned long long n) {
     assert((node->flags & GC_BOTH) == GC_BOTH);
     for (unsigned long long i = 0; i < n; ++i) {
-        node = node->data.branches.right;
+        node = getRight(node);
         assert((node->flags & GC_BOTH) == GC_BOTH);
     }
-    return node->data.branches.left;
+    return getLeft(node);
+}
+
+Tag newPrefixedTag(Lexeme lexeme, char fixity, char prefix) {
+    // tags hold interned lexemes so that they can be compared in constant time
+    Node* node = newNode(NULL, GC_NONE, fixity, prefix);
+    *newLexemeSlot(node) = internLexeme(lexeme);
+    return (Tag)node;
 }
 
 Tag newTag(Lexeme lexeme, char fixity) {
-    return (Tag)copyNode((Node*)allocate(), &(Node)
-        {.referenceCount=0, .flags=GC_NONE, .type=fixity, .variety=0,
-        .tag=NULL, .data={.lexeme=lexeme}});
+    return newPrefixedTag(lexeme, fixity, 0);
 }
 
 Tag newLiteralTag(const char* name, Location location, char fixity) {
@@ -124,14 +579,11 @@ Tag newLiteralTag(const char* name, Location location, char fixity) {
 }
 
 Tag addPrefix(Tag tag, char prefix) {
-    Node* node = copyNode((Node*)allocate(), (Node*)tag);
-    node->referenceCount = 0;
-    node->variety = prefix;
-    return (Tag)node;
+    return newPrefixedTag(getLexeme(tag), getTagFixity(tag), prefix);
 }
 
 Lexeme getLexeme(Tag tag) {
-    return ((Node*)tag)->data.lexeme;
+    return *getLexemeSlot((Node*)tag);
 }
 
 char getTagFixity(Tag tag) {
@@ -140,16 +592,16 @@ char getTagFixity(Tag tag) {
 
 bool isThisTag(Tag a, const char* b) {
     return ((Node*)a)->variety == '\0' &&
-        isThisLexeme(((Node*)a)->data.lexeme, b);
+        isThisLexeme(getLexeme(a), b);
 }
 
 bool isSameTag(Tag a, Tag b) {
     return ((Node*)a)->variety == ((Node*)b)->variety &&
-        isSameLexeme(((Node*)a)->data.lexeme, ((Node*)b)->data.lexeme);
+        isSameSymbol(getLexeme(a), getLexeme(b));
 }
 
 void printTag(Tag tag, FILE* stream) {
-    Lexeme lexeme = ((Node*)tag)->data.lexeme;
+    Lexeme lexeme = getLexeme(tag);
     if (((Node*)tag)->variety == '\0' && lexeme.length > 0 &&
             lexeme.start[0] == '\n') {
         fputs("(end of line)", stream);
@@ -164,7 +616,7 @@ void printTagWithLocation(Tag tag, FILE* stream) {
     fputs("'", stream);
     printTag(tag, stream);
     fputs("' at ", stream);
-    printLocation(((Node*)tag)->data.lexeme.location, stream);
+    printLocation(getLexeme(tag).location, stream);
 }
 
 void syntaxError(const char* message, Tag tag) {
@@ -7,12 +7,22 @@
 typedef struct Node Node;
 typedef struct Tag* Tag;
 
-void initNodeAllocator(void);
+// latency builds print their histogram on exit if TIMING is set, see -T
+extern bool TIMING;
+
+void initNodeAllocator(size_t pageCapacity, bool hugePages);
 void destroyNodeAllocator(void);
+void flushReleases(void);
+void releaseFreeMemory(void);
 
 Node* newBranch(Tag tag, char type, char variety, Node* left, Node* right);
 Node* newPair(Node* left, Node* right);
 Node* newLeaf(Tag tag, char type, char variety, long long data);
+Node* newUntaggedLeaf(char type, long long data);
+Node* newSharedBranch(Tag tag, char type, char variety, Node* left,
+    Node* right);
+Node* newSharedLeaf(Tag tag, char type, char variety, long long data);
+void releaseSharedNodes(void);
 Node* newPointerLeaf(Tag tag, char type, char variety, void* data);
 
 Tag getTag(Node* node);
@@ -21,6 +31,7 @@ Node* getLeft(Node* branchNode);
 Node* getRight(Node* branchNode);
 void setLeft(Node* branchNode, Node* left);
 void setRight(Node* branchNode, Node* right);
+bool isBranch(Node* node);
 char getType(Node* node);
 void setType(Node* node, char type);
 char getVariety(Node* node);
@@ -32,11 +43,13 @@ void* getData(Node* leafNode);
 typedef struct Node Hold;
 Hold* hold(Node* node);
 void release(Hold* node);
+unsigned int getReferenceCount(Node* node);
 
 Node* getListElement(Node* node, unsigned long long n);
 
 Tag newTag(Lexeme lexeme, char fixity);
 Tag newLiteralTag(const char* name, Location location, char fixity);
+Tag newPrefixedTag(Lexeme lexeme, char fixity, char prefix);
 Tag addPrefix(Tag tag, char prefix);
 Lexeme getLexeme(Tag tag);
 char getTagFixity(Tag tag);
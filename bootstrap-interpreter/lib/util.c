@@ -3,6 +3,7 @@
 #include "util.h"
 
 void* error(const char* message) {
+    fflush(stdout);
     fputs(message, stderr);
     exit(1);
     return NULL;
@@ -34,6 +34,26 @@ static inline void updateClosure(Closure* closure, Closure* update) {
     setLocals(closure, getLocals(update));
 }
 
+// an updated closure can keep its unevaluated source in its otherwise unused
+// tag, so that serializing it does not depend on whether it was updated
+static inline void saveSource(Closure* closure) {
+    if (getTag(closure) == NULL)
+        setTag(closure, (Tag)newClosure(getTerm(closure), getLocals(closure),
+            getTrace(closure)));
+}
+
+// operands used by an operation are serialized as their values, as they were
+// before thunks were shared, so they drop any source that was saved
+static inline void forgetSource(Closure* closure) {
+    if (getTag(closure) != NULL)
+        setTag(closure, NULL);
+}
+
+static inline Closure* getSource(Closure* closure) {
+    Tag source = getTag(closure);
+    return source == NULL ? closure : (Closure*)source;
+}
+
 static inline void setClosure(Closure* closure, Closure* update) {
     setTerm(closure, getTerm(update));
     if (TRACE)
@@ -0,0 +1,185 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "util.h"
+#include "tree.h"
+#include "array.h"
+#include "parse/term.h"
+#include "compile.h"
+
+typedef struct {
+    Term* term;
+    size_t index;
+} Entry;
+
+// entries map every compiled term to the start of its sequence so that the
+// evaluator can find the code for a closure, which holds a term
+struct Code {
+    size_t length, capacity, entryCount, entryCapacity;
+    Instruction* instructions;
+    Entry* entries;
+};
+
+static size_t hashTerm(const Code* code, Term* term) {
+    unsigned long long hash = (unsigned long long)(uintptr_t)term;
+    hash = (hash ^ (hash >> 17)) * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 32) & (code->entryCapacity - 1);
+}
+
+static Entry* findEntry(const Code* code, Term* term) {
+    size_t i = hashTerm(code, term);
+    while (code->entries[i].term != term && code->entries[i].term != NULL)
+        i = (i + 1) & (code->entryCapacity - 1);
+    return &code->entries[i];
+}
+
+static void resizeEntries(Code* code, size_t capacity) {
+    Entry* entries = code->entries;
+    size_t oldCapacity = code->entryCapacity;
+    code->entries = (Entry*)calloc(capacity, sizeof(Entry));
+    if (code->entries == NULL)
+        error("\nError: out of memory\n");
+    code->entryCapacity = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i)
+        if (entries[i].term != NULL)
+            *findEntry(code, entries[i].term) = entries[i];
+    free(entries);
+}
+
+static Entry* getEntry(const Code* code, Term* term) {
+    // globals only refer to earlier globals, which are compiled first
+    Entry* entry = findEntry(code, term);
+    assert(entry->term != NULL);
+    return entry;
+}
+
+static void addEntry(Code* code, Term* term) {
+    if (2 * (code->entryCount + 1) > code->entryCapacity)
+        resizeEntries(code, 2 * code->entryCapacity);
+    *findEntry(code, term) = (Entry){term, code->length};
+    code->entryCount += 1;
+}
+
+static void emit(Code* code, Opcode opcode, unsigned long long operand,
+        Term* term) {
+    if (code->length == code->capacity) {
+        code->capacity = 2 * code->capacity;
+        size_t newSize = code->capacity * sizeof(Instruction);
+        code->instructions = (Instruction*)realloc(code->instructions, newSize);
+        if (code->instructions == NULL)
+            error("\nError: out of memory\n");
+    }
+    code->instructions[code->length++] = (Instruction){opcode, operand, term};
+}
+
+static void emitArgument(Code* code, Term* argument, Array* pending) {
+    // mirrors optimizeClosure in evaluate.c
+    switch (getTermType(argument)) {
+        case VARIABLE:
+            if (!isGlobal(argument)) {
+                emit(code, PUSH_LOCAL, getDebruijnIndex(argument), argument);
+                return;
+            }
+            emit(code, PUSH_CONSTANT, 0, argument); break;
+        case NUMERAL:
+        case PACKEDSTRING:
+        case OPERATION: emit(code, PUSH_CONSTANT, 0, argument); break;
+        default: emit(code, PUSH_CLOSURE, 0, argument); break;
+    }
+    append(pending, argument);
+}
+
+static void emitHead(Code* code, Term* head, const Array* globals,
+        Array* pending) {
+    switch (getTermType(head)) {
+        case VARIABLE:
+            if (isGlobal(head))
+                emit(code, ENTER_GLOBAL, getEntry(code,
+                    getGlobalReferent(head, globals))->index, head);
+            else
+                emit(code, ENTER_LOCAL, getDebruijnIndex(head), head);
+            break;
+        case NUMERAL: emit(code, NUMBER, 0, head); break;
+        case PACKEDSTRING: emit(code, UNPACK, 0, head); break;
+        case OPERATION:
+            if (isPseudoOperation(getOperationCode(head))) {
+                emit(code, OPERATE, 0, head);
+            } else {
+                emit(code, ARITHMETIC, 0, head);
+                append(pending, getRight(head));
+            }
+            break;
+        default: assert(false); break;
+    }
+}
+
+static void compileSequence(Code* code, Term* term, const Array* globals,
+        Array* pending) {
+    for (;;) {
+        Entry* entry = findEntry(code, term);
+        if (entry->term != NULL) {
+            emit(code, JUMP, entry->index, term);
+            return;
+        }
+        addEntry(code, term);
+        if (isApplication(term)) {
+            emitArgument(code, getRight(term), pending);
+            term = getLeft(term);
+        } else if (isAbstraction(term)) {
+            emit(code, GRAB, 0, term);
+            term = getBody(term);
+        } else {
+            emitHead(code, term, globals, pending);
+            return;
+        }
+    }
+}
+
+static Opcode fuse(Opcode first, Opcode second) {
+    if (first == GRAB && second == GRAB)
+        return GRAB_TWO;
+    if (first == PUSH_LOCAL && second == ENTER_LOCAL)
+        return PUSH_ENTER_LOCAL;
+    return first;
+}
+
+static void fuseInstructions(Code* code) {
+    for (size_t i = 0; i + 1 < code->length; ++i)
+        code->instructions[i].opcode = fuse(code->instructions[i].opcode,
+            code->instructions[i + 1].opcode);
+}
+
+Code* compile(const Array* globals) {
+    Code* code = (Code*)smalloc(sizeof(Code));
+    code->length = code->entryCount = code->entryCapacity = 0;
+    code->capacity = 1024;
+    code->instructions = (Instruction*)smalloc(
+        code->capacity * sizeof(Instruction));
+    code->entries = NULL;
+    resizeEntries(code, 1024);
+    Array* pending = newArray(1024);
+    for (size_t i = 0; i < length(globals); ++i)
+        append(pending, elementAt(globals, i));
+    for (size_t i = 0; i < length(pending); ++i)
+        if (findEntry(code, elementAt(pending, i))->term == NULL)
+            compileSequence(code, elementAt(pending, i), globals, pending);
+    deleteArray(pending);
+    fuseInstructions(code);
+    return code;
+}
+
+void deleteCode(Code* code) {
+    if (code == NULL)
+        return;
+    free(code->instructions);
+    free(code->entries);
+    free(code);
+}
+
+const Instruction* findInstruction(const Code* code, Term* term) {
+    Entry* entry = findEntry(code, term);
+    return entry->term == NULL ? NULL : &code->instructions[entry->index];
+}
+
+const Instruction* jump(const Code* code, const Instruction* instruction) {
+    return &code->instructions[instruction->operand];
+}
@@ -0,0 +1,22 @@
+// each term compiles to a straight-line sequence that pushes the arguments of
+// its application spine and then either grabs an argument or enters its head,
+// so the evaluator only has to look at the term tree when it enters a closure
+// the last few opcodes are superinstructions that fuse common sequences,
+// which are still followed by the instructions they fuse so that they can
+// fall back to them and so that jumps into the middle of them still work
+typedef enum {PUSH_LOCAL, PUSH_CONSTANT, PUSH_CLOSURE, GRAB, ENTER_LOCAL,
+    ENTER_GLOBAL, NUMBER, OPERATE, UNPACK, JUMP,
+    GRAB_TWO, PUSH_ENTER_LOCAL, ARITHMETIC} Opcode;
+
+typedef struct {
+    Opcode opcode;
+    unsigned long long operand;     // debruijn index or jump target
+    Term* term;
+} Instruction;
+
+typedef struct Code Code;
+
+Code* compile(const Array* globals);
+void deleteCode(Code* code);
+const Instruction* findInstruction(const Code* code, Term* term);
+const Instruction* jump(const Code* code, const Instruction* instruction);
@@ -1,37 +1,53 @@
 #include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "freelist.h"
 #include "tree.h"
+#include "profile.h"
 #include "stack.h"
+#include "spine.h"
 #include "array.h"
 #include "parse/term.h"
 #include "closure.h"
+#include "compile.h"
 #include "exception.h"
 #include "operations.h"
 #include "evaluate.h"
 
 extern bool isIO;
 static volatile bool INTERRUPT = false;
+static const Code* CODE = NULL;
+static Closure* EVALUATING = NULL;
+static Tag EXPANSION_TAG = NULL;
+static Array* UNPACKED = NULL;
 
-static Node* evaluateClosure(Closure* closure, Array* globals);
+// constants are shared closures for globals that are defined by applications,
+// so that they are evaluated at most once. they can retain a lot of memory, so
+// the older half of them is released if memory usage exceeds the limit when
+// a new one is created, which costs each constant at most one release. the
+// limit is half of the memory limit, and all of them are released before
+// the memory limit is reported as exceeded
+static size_t CONSTANT_MEMORY_LIMIT = (size_t)1 << 30;
+static Hold** CONSTANTS = NULL;
+static size_t* FILLED = NULL;   // indexes of the held constants, oldest first
+static size_t FILLED_COUNT = 0;
 
-static bool isUpdate(Closure* closure) {
-    return getVariety(closure) == 1;
-}
-
-static Closure* setUpdate(Closure* closure, bool update) {
-    setVariety(closure, update ? 1 : 0);
-    return closure;
-}
-
-static void eraseUpdates(Stack* stack) {
-    while (!isEmpty(stack) && isUpdate(peek(stack, 0)))
-        release(setUpdate(pop(stack), false));
+static void eraseUpdates(Spine* spine) {
+    while (isUpdateFrame(spine, 0)) {
+        release(popFrame(spine));
+        PROFILED(restoreSite());
+    }
 }
 
-static void applyUpdates(Closure* evaluatedClosure, Stack* stack) {
-    while (!isEmpty(stack) && isUpdate(peek(stack, 0))) {
-        Hold* update = pop(stack);
-        updateClosure(setUpdate(update, false), evaluatedClosure);
+static void applyUpdates(Closure* evaluatedClosure, Spine* spine) {
+    while (isUpdateFrame(spine, 0)) {
+        Hold* update = popFrame(spine);
+        if (!isIO)
+            saveSource(update);
+        updateClosure(update, evaluatedClosure);
         release(update);
+        PROFILED(restoreSite());
     }
 }
 
@@ -44,6 +60,7 @@ static Closure* optimizeClosure(Term* term, Node* locals, Node* trace) {
     // the other cases are short-circuit optmizations
     switch (getTermType(term)) {
         case OPERATION:
+        case PACKEDSTRING:
         case NUMERAL: return newClosure(term, NULL, trace);
         case VARIABLE: return isGlobal(term) ?
             newClosure(term, NULL, trace) : getLocalReferent(term, locals);
@@ -51,144 +68,543 @@ static Closure* optimizeClosure(Term* term, Node* locals, Node* trace) {
     }
 }
 
-static void evaluateApplication(Closure* closure, Stack* stack) {
-    // push right side of application onto stack and step into left side
+static void evaluateApplication(Closure* closure, Spine* spine) {
+    // push right side of application onto spine and step into left side
     Term* application = getTerm(closure);
-    push(stack, optimizeClosure(
+    pushArgument(spine, optimizeClosure(
         getRight(application), getLocals(closure), getTrace(closure)));
     setTerm(closure, getLeft(application));
 }
 
-static void evaluateAbstraction(Closure* closure, Stack* stack) {
-    // move argument from stack to local environment and step into body
-    Hold* argument = pop(stack);
+static void evaluateAbstraction(Closure* closure, Spine* spine) {
+    // move argument from spine to local environment and step into body
+    Hold* argument = popFrame(spine);
     push((Stack*)closure, argument);
     release(argument);
     setTerm(closure, getBody(getTerm(closure)));
 }
 
-static void evaluateVariable(Closure* closure, Stack* stack, Array* globals) {
-    Term* variable = getTerm(closure);
-    if (isGlobal(variable)) {
-        setTerm(closure, getGlobalReferent(variable, globals));
-        if (TRACE)
-            push((Stack*)getBacktrace(closure), variable);
-        setLocals(closure, NULL);
-    } else {
-        // lookup referenced closure in the local environment and switch to it
-        Closure* referent = getLocalReferent(variable, getLocals(closure));
-        // only optimize in IO mode so that term serializations are standardized
-        if (isIO && !isValue(getTerm(referent)) && !isUpdate(referent))
-            push(stack, setUpdate(referent, true));
-        setClosure(closure, referent);
+static void switchClosure(Closure* closure, Closure* referent, Spine* spine) {
+    if (!isValue(getTerm(referent))) {
+        pushUpdate(spine, referent);
+        PROFILED(saveSite());
     }
+    setClosure(closure, referent);
 }
 
-static void evaluateOperation(Closure* closure, Stack* stack, Array* globals) {
-    unsigned int arity = getArity(getTerm(closure));
+static void enterGlobal(Closure* closure, Term* global, Array* globals) {
+    setTerm(closure, getGlobalReferent(global, globals));
+    if (TRACE)
+        push((Stack*)getBacktrace(closure), global);
     setLocals(closure, NULL);
-    applyUpdates(closure, stack);
-    Hold* left = arity >= 1 && !isEmpty(stack) ? pop(stack) : NULL;
-    eraseUpdates(stack);    // partially applied operations are not values
-    Hold* right = arity >= 2 && !isEmpty(stack) ? pop(stack) : NULL;
-
-    // save the closure data since evaluate will mutate the closure and we
-    // may have to revert if the operation optimization does not work
-    Hold* leftTerm = left == NULL ? NULL : hold(getTerm(left));
-    Hold* leftLocals = left == NULL ? NULL : hold(getLocals(left));
-    Hold* rightTerm = right == NULL ? NULL : hold(getTerm(right));
-    Hold* rightLocals = right == NULL ? NULL : hold(getLocals(right));
-
-    // left and right may be mutated in evaluateClosure
-    Hold* result = evaluateOperationTerm(closure,
-        left == NULL ? NULL : evaluateClosure(left, globals),
-        right == NULL ? NULL : evaluateClosure(right, globals));
+}
 
-    if (result == NULL) {
-        // restore stack to it's original state
-        if (right != NULL) {
-            setTerm(right, rightTerm);
-            setLocals(right, rightLocals);
-            push(stack, right);
-        }
-        if (left != NULL) {
-            setTerm(left, leftTerm);
-            setLocals(left, leftLocals);
-            push(stack, left);
-        }
+static void releaseOldConstants(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        release(CONSTANTS[FILLED[i]]);
+        CONSTANTS[FILLED[i]] = NULL;
     }
-    if (right != NULL) {
-        release(rightTerm);
-        release(rightLocals);
-        release(right);
+    FILLED_COUNT -= count;
+    memmove(FILLED, &FILLED[count], FILLED_COUNT * sizeof(size_t));
+}
+
+void releaseConstants(void) {releaseOldConstants(FILLED_COUNT);}
+
+static Closure* getConstant(Term* global, Term* referent, Node* trace) {
+    size_t i = (size_t)(-getValue(global) - 1);
+    if (CONSTANTS[i] == NULL) {
+        if (getMemoryUsage() > CONSTANT_MEMORY_LIMIT) {
+            releaseOldConstants((FILLED_COUNT + 1) / 2);
+            releaseFreeMemory();
+        }
+        CONSTANTS[i] = hold(newClosure(referent, NULL, trace));
+        FILLED[FILLED_COUNT++] = i;
     }
-    if (left != NULL) {
-        release(leftTerm);
-        release(leftLocals);
-        release(left);
+    return CONSTANTS[i];
+}
+
+static bool enterConstant(Closure* closure, Term* global, Array* globals,
+        Spine* spine) {
+    // constants are not shared when tracing so that the backtrace of each
+    // reference is kept
+    Term* referent = getGlobalReferent(global, globals);
+    if (TRACE || !isApplication(referent))
+        return false;
+    switchClosure(closure, getConstant(global, referent, getTrace(closure)),
+        spine);
+    return true;
+}
+
+static void evaluateVariable(Closure* closure, Spine* spine, Array* globals) {
+    Term* variable = getTerm(closure);
+    if (isGlobal(variable)) {
+        PROFILED(enterSite(getTag(variable)));
+        if (!enterConstant(closure, variable, globals, spine))
+            enterGlobal(closure, variable, globals);
+    } else {
+        // lookup referenced closure in the local environment and switch to it
+        switchClosure(closure, getLocalReferent(variable, getLocals(closure)),
+            spine);
     }
+}
+
+static void forgetSources(Closure* left, Closure* right) {
+    // operands that an operation used are serialized as their values, but
+    // operands of an operation that falls back keep their sources
+    if (isIO)
+        return;
+    if (left != NULL)
+        forgetSource(left);
+    if (right != NULL)
+        forgetSource(right);
+}
+
+static void applyOperation(Closure* closure, Spine* spine, Closure* left,
+        Closure* right) {
+    Hold* result = evaluateOperationTerm(closure, left, right);
     if (result == NULL) {
+        // restore spine to it's original state
+        if (right != NULL)
+            pushArgument(spine, right);
+        if (left != NULL)
+            pushArgument(spine, left);
         Node* fallback = getRight(getTerm(closure));
         if (fallback == NULL)  // pseudo-operation, no definiens term
             runtimeError("missing argument to", closure);
         setTerm(closure, fallback);
     } else {
+        forgetSources(left, right);
         setClosure(closure, result);
         release(result);
     }
 }
 
+static Closure* getPendingOperand(Closure* left, Closure* right) {
+    // operands are evaluated from left to right
+    if (left != NULL && !isValue(getTerm(left)))
+        return left;
+    return right != NULL && !isValue(getTerm(right)) ? right : NULL;
+}
+
+static void evaluateOperation(Closure* closure, Spine* spine) {
+    unsigned int arity = getArity(getTerm(closure));
+    setLocals(closure, NULL);
+    applyUpdates(closure, spine);
+    Hold* left = arity >= 1 && hasArguments(spine, 1) ? popFrame(spine) : NULL;
+    eraseUpdates(spine);    // partially applied operations are not values
+    Hold* right = arity >= 2 && hasArguments(spine, 1) ?
+        popFrame(spine) : NULL;
+    Closure* operand = getPendingOperand(left, right);
+    if (operand == NULL) {
+        applyOperation(closure, spine, left, right);
+    } else {
+        // the operation waits in a continuation frame above its operands
+        // while the evaluator switches to the first pending operand
+        pushOperand(spine, right);
+        pushOperand(spine, left);
+        pushContinuation(spine,
+            newClosure(getTerm(closure), NULL, getTrace(closure)));
+        PROFILED(saveSite());
+        setClosure(closure, operand);
+    }
+    release(right);
+    release(left);
+}
+
+static void resumeOperation(Closure* closure, Spine* spine) {
+    // the closure is the value of the pending operand, which is updated
+    // with it as if the operand had been evaluated in place
+    Closure* left = peekFrame(spine, 1);
+    Closure* right = peekFrame(spine, 2);
+    Closure* operand = getPendingOperand(left, right);
+    if (!isIO)
+        saveSource(operand);
+    updateClosure(operand, closure);
+    operand = getPendingOperand(left, right);
+    PROFILED(restoreSite());
+    if (operand != NULL) {
+        PROFILED(saveSite());
+        setClosure(closure, operand);
+        return;
+    }
+    Hold* continuation = popFrame(spine);
+    left = popFrame(spine);
+    right = popFrame(spine);
+    setClosure(closure, continuation);
+    applyOperation(closure, spine, left, right);
+    release(right);
+    release(left);
+    release(continuation);
+}
+
+static Tag getExpansionTag(Term* numeral) {
+    // computed numerals are untagged and have no location to report, so
+    // their expansions can all have the same tag, which lets them be shared
+    if (getTag(numeral) != NULL)
+        return newLiteralTag("_", getLexeme(getTag(numeral)).location, 0);
+    if (EXPANSION_TAG == NULL)
+        EXPANSION_TAG = (Tag)hold((Node*)newLiteralTag("_", EMPTY.location, 0));
+    return EXPANSION_TAG;
+}
+
 static Term* expandNumeral(Term* numeral) {
     long long n = getValue(numeral);
-    Tag tag = newLiteralTag("_", getLexeme(getTag(numeral)).location, 0);
-    Term* body = n == 0 ? Variable(tag, 2) :
-       Application(tag, Variable(tag, 1), Numeral(tag, n - 1));
-    return Abstraction(tag, Abstraction(tag, body));
+    Tag tag = getExpansionTag(numeral);
+    Term* body = n == 0 ? SharedVariable(tag, 2) : SharedApplication(tag,
+        SharedVariable(tag, 1), UntaggedNumeral(n - 1));
+    return SharedAbstraction(tag, SharedAbstraction(tag, body));
+}
+
+static void matchNumeral(Closure* closure, Spine* spine) {
+    // n(zero, successor) is zero if n is 0 and successor(n - 1) otherwise,
+    // which is what the expansion computes, but without building it
+    long long n = getValue(getTerm(closure));
+    Hold* zero = popFrame(spine);
+    Hold* successor = popFrame(spine);
+    if (n > 0)
+        pushArgument(spine,
+            newClosure(UntaggedNumeral(n - 1), NULL, getTrace(closure)));
+    switchClosure(closure, n == 0 ? zero : successor, spine);
+    release(successor);
+    release(zero);
 }
 
-static void evaluateNumeral(Closure* closure) {
+static void evaluateNumeral(Closure* closure, Spine* spine) {
+    if (hasArguments(spine, 2)) {
+        matchNumeral(closure, spine);
+    } else {
+        // a partially applied numeral is expanded so it can be serialized
+        setLocals(closure, NULL);
+        setTerm(closure, expandNumeral(getTerm(closure)));
+    }
+}
+
+static void unpackString(Closure* closure) {
+    // a packed string is unpacked when it is first matched, all at once and
+    // in place, so it costs no more than the list it stands for and every
+    // closure that refers to it sees the list. strings that are written
+    // without being matched stay packed, see writeString
+    Term* string = getTerm(closure);
+    Tag tag = getTag(string);
+    Term* cons = getPackedCons(string);
+    const char* bytes = getPackedBytes(string);
+    append(UNPACKED, hold(newPair(string,
+        newPair(getLeft(string), getRight(string)))));
+    Hold* list = hold(getPackedNil(string));
+    for (size_t i = strlen(bytes) - 1; i > 0; --i) {
+        Hold* rest = list;
+        list = hold(Application(tag, Application(tag, cons,
+            SharedNumeral((unsigned char)bytes[i])), rest));
+        release(rest);
+    }
+    setLeft(string, Application(tag, cons,
+        SharedNumeral((unsigned char)bytes[0])));
+    setRight(string, list);
+    setType(string, APPLICATION);
+    release(list);
     setLocals(closure, NULL);
-    setTerm(closure, expandNumeral(getTerm(closure)));
 }
 
-static Closure* evaluate(Closure* closure, Stack* stack, Array* globals) {
+static void repackStrings(void) {
+    // unpacked strings are packed again after evaluation, so the program
+    // is left as it was parsed
+    while (length(UNPACKED) > 0) {
+        Hold* unpacked = unappend(UNPACKED);
+        Term* string = getLeft(unpacked);
+        setLeft(string, getLeft(getRight(unpacked)));
+        setRight(string, getRight(getRight(unpacked)));
+        setType(string, PACKEDSTRING);
+        release(unpacked);
+    }
+}
+
+static bool step(Closure* closure, Spine* spine, Array* globals) {
+    // returns true if the closure is a value with nothing left to apply
+    TermType type = getTermType(getTerm(closure));
+    if (isValueType(type)) {
+        applyUpdates(closure, spine);
+        if (isSpineEmpty(spine))
+            return true;
+        if (isContinuationFrame(spine, 0)) {
+            resumeOperation(closure, spine);
+            return false;
+        }
+    }
+    switch (type) {
+        case VARIABLE: evaluateVariable(closure, spine, globals); break;
+        case ABSTRACTION: evaluateAbstraction(closure, spine); break;
+        case APPLICATION: evaluateApplication(closure, spine); break;
+        case NUMERAL: evaluateNumeral(closure, spine); break;
+        case OPERATION: evaluateOperation(closure, spine); break;
+        case PACKEDSTRING: unpackString(closure); break;
+    }
+    return false;
+}
+
+static Closure* walk(Closure* closure, Spine* spine, Array* globals) {
     while (true) {
         assert(INTERRUPT ? (runtimeError("interrupted", closure), 0) : 1);
-        TermType type = getTermType(getTerm(closure));
-        if (isValueType(type)) {
-            applyUpdates(closure, stack);
-            if (isEmpty(stack))
+        if (step(closure, spine, globals))
+            return closure;
+    }
+}
+
+static bool computeArithmetic(Closure* closure, Spine* spine, Term* operation) {
+    // an arithmetic operation applied to numerals needs none of the operand
+    // evaluation and fallback handling in evaluateOperation
+    unsigned int arity = getArity(operation);
+    if (!hasArguments(spine, arity))
+        return false;
+    for (size_t i = 0; i < arity; ++i)
+        if (!isNumeral(getTerm(peekFrame(spine, i))))
+            return false;
+    setTerm(closure, operation);
+    setLocals(closure, NULL);
+    Hold* left = popFrame(spine);
+    Hold* right = arity == 2 ? popFrame(spine) : NULL;
+    forgetSources(left, right);
+    Hold* result = evaluateOperationTerm(closure, left, right);
+    setClosure(closure, result);
+    release(result);
+    release(right);
+    release(left);
+    return true;
+}
+
+static void grabArgument(Closure* closure, Spine* spine) {
+    Hold* argument = popFrame(spine);
+    push((Stack*)closure, argument);
+    release(argument);
+}
+
+// with gcc and clang, each instruction jumps directly to the next one through
+// a table of label addresses, which predicts better than a shared switch
+#if defined(__GNUC__) && !defined(NO_THREADING)
+#define THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define TARGET(opcode) case opcode: opcode##_TARGET
+#define DISPATCH() goto *TARGETS[instruction->opcode]
+#else
+#define TARGET(opcode) case opcode
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do {++instruction; DISPATCH();} while (false)
+#define ENTER(next) do {instruction = (next); goto dispatch;} while (false)
+
+static Closure* execute(Closure* closure, Spine* spine, Array* globals) {
+    // the closure term is only brought up to date where it can be observed,
+    // which is when entering a head or when the closure might be a value
+#ifdef THREADED
+    // must line up with Opcode
+    static void* const TARGETS[] = {&&PUSH_LOCAL_TARGET, &&PUSH_CONSTANT_TARGET,
+        &&PUSH_CLOSURE_TARGET, &&GRAB_TARGET, &&ENTER_LOCAL_TARGET,
+        &&ENTER_GLOBAL_TARGET, &&NUMBER_TARGET, &&OPERATE_TARGET,
+        &&UNPACK_TARGET, &&JUMP_TARGET, &&GRAB_TWO_TARGET,
+        &&PUSH_ENTER_LOCAL_TARGET, &&ARITHMETIC_TARGET};
+#endif
+    const Instruction* instruction = findInstruction(CODE, getTerm(closure));
+    dispatch:
+    assert(INTERRUPT ? (runtimeError("interrupted", closure), 0) : 1);
+    while (instruction == NULL) {
+        // terms built during evaluation have no code
+        if (step(closure, spine, globals))
+            return closure;
+        instruction = findInstruction(CODE, getTerm(closure));
+    }
+    switch (instruction->opcode) {
+        TARGET(PUSH_LOCAL):
+            pushArgument(spine,
+                getListElement(getLocals(closure), instruction->operand - 1));
+            NEXT();
+        TARGET(PUSH_CONSTANT):
+            pushArgument(spine,
+                newClosure(instruction->term, NULL, getTrace(closure)));
+            NEXT();
+        TARGET(PUSH_CLOSURE):
+            pushArgument(spine, newClosure(instruction->term,
+                getLocals(closure), getTrace(closure)));
+            NEXT();
+        TARGET(GRAB_TWO):
+            if (hasArguments(spine, 2)) {
+                grabArgument(closure, spine);
+                grabArgument(closure, spine);
+                instruction += 2;
+                DISPATCH();
+            }
+            goto grab;
+        TARGET(GRAB):
+            grab:
+            if (hasArguments(spine, 1)) {
+                grabArgument(closure, spine);
+                NEXT();
+            }
+            setTerm(closure, instruction->term);
+            if (step(closure, spine, globals))
                 return closure;
-        }
-        switch (type) {
-            case VARIABLE: evaluateVariable(closure, stack, globals); break;
-            case ABSTRACTION: evaluateAbstraction(closure, stack); break;
-            case APPLICATION: evaluateApplication(closure, stack); break;
-            case NUMERAL: evaluateNumeral(closure); break;
-            case OPERATION: evaluateOperation(closure, stack, globals); break;
-        }
+            // the value may have resumed an operation instead of grabbing
+            if (getTerm(closure) != getBody(instruction->term))
+                ENTER(findInstruction(CODE, getTerm(closure)));
+            NEXT();
+        TARGET(PUSH_ENTER_LOCAL):
+            pushArgument(spine,
+                getListElement(getLocals(closure), instruction->operand - 1));
+            ++instruction;
+            goto enterLocal;
+        TARGET(ENTER_LOCAL):
+            enterLocal:
+            switchClosure(closure, getListElement(getLocals(closure),
+                instruction->operand - 1), spine);
+            ENTER(findInstruction(CODE, getTerm(closure)));
+        TARGET(ENTER_GLOBAL):
+            PROFILED(enterSite(getTag(instruction->term)));
+            if (enterConstant(closure, instruction->term, globals, spine))
+                ENTER(findInstruction(CODE, getTerm(closure)));
+            enterGlobal(closure, instruction->term, globals);
+            ENTER(jump(CODE, instruction));
+        TARGET(ARITHMETIC):
+            if (computeArithmetic(closure, spine, instruction->term))
+                ENTER(findInstruction(CODE, getTerm(closure)));
+            goto operate;
+        TARGET(NUMBER):
+        TARGET(OPERATE):
+        TARGET(UNPACK):
+            operate:
+            setTerm(closure, instruction->term);
+            if (step(closure, spine, globals))
+                return closure;
+            ENTER(findInstruction(CODE, getTerm(closure)));
+        TARGET(JUMP):
+            instruction = jump(CODE, instruction);
+            DISPATCH();
     }
+    assert(false);
+    return NULL;
 }
 
-static Closure* evaluateClosure(Closure* closure, Array* globals) {
+#ifdef THREADED
+#pragma GCC diagnostic pop
+#endif
+
+static Closure* evaluateClosure(Closure* closure, Spine* spine,
+        Array* globals) {
     if (isValue(getTerm(closure)))
         return closure;
-    Stack* stack = newStack();
-    Node* result = evaluate(closure, stack, globals);
-    deleteStack(stack);
-    return result;
+    return CODE == NULL ? walk(closure, spine, globals) :
+        execute(closure, spine, globals);
 }
 
 static void interrupt(int parameter) {(void)parameter; INTERRUPT = true;}
 
-Hold* evaluateTerm(Term* term, Array* globals) {
-    (void)interrupt;
-    INPUT_STACK = newStack();
+static void exceedMemoryLimit(void) {
+    if (FILLED_COUNT > 0) {
+        releaseConstants();
+        releaseFreeMemory();
+        return;
+    }
+    // the closure is evaluated in place, so it holds the current term, which
+    // may be an untagged numeral
+    if (getTag(getTerm(EVALUATING)) == NULL)
+        error("\nRuntime error: memory limit exceeded\n");
+    runtimeError("memory limit exceeded evaluating", EVALUATING);
+}
+
+static Hold* evaluateValue(Term* term, Spine* spine, Array* globals) {
     Hold* closure = hold(newClosure(term, NULL, NULL));
-    assert(signal(SIGINT, interrupt) != SIG_ERR);
-    Hold* result = hold(evaluateClosure(closure, globals));
-    assert(signal(SIGINT, SIG_DFL) != SIG_ERR);
+    EVALUATING = closure;
+    Hold* result = hold(evaluateClosure(closure, spine, globals));
     release(closure);
-    deleteStack(INPUT_STACK);
+    return result;
+}
+
+static Hold* evaluateLocal(Term* term, Closure* local, Spine* spine,
+        Array* globals) {
+    // evaluates a term in which variable 1 refers to the local closure,
+    // which is reported if the memory limit is hit before the closure exists
+    EVALUATING = local;
+    Hold* closure = hold(newClosure(term, newPair(local, NULL), NULL));
+    EVALUATING = closure;
+    return evaluateClosure(closure, spine, globals);
+}
+
+static void writeByte(Closure* head) {
+    if (!isNumeral(getTerm(head)))
+        runtimeError("expected numeric output from", head);
+    long long c = getValue(getTerm(head));
+    if (c >= 0 && c < 256)
+        fputc((int)c, stdout);
+}
+
+static Closure* writeString(Closure* list) {
+    // writes the rest of a list at once if it is a packed string, and
+    // returns what is left to write
+    if (!isPackedString(getTerm(list)))
+        return list;
+    fputs(getPackedBytes(getTerm(list)), stdout);
+    return newClosure(getPackedNil(getTerm(list)), NULL, NULL);
+}
+
+static Hold* writeOutput(Term* term, Spine* spine, Array* globals) {
+    // the output of main is walked a cell at a time by matching each cell
+    // with a case for [] and a case for (::) that returns its head and tail,
+    // and only the head is evaluated, so the written cells can be released
+    Tag tag = getTag(term);
+    Term* nilCase = Abstraction(tag, Variable(tag, 1));
+    Term* consCase = Abstraction(tag, Abstraction(tag,
+        Abstraction(tag, Variable(tag, 1))));
+    Hold* match = hold(Application(tag,
+        Application(tag, Variable(tag, 1), nilCase), consCase));
+    Hold* force = hold(Variable(tag, 1));
+    Hold* list = hold(newClosure(term, NULL, NULL));
+    Hold* cell = evaluateLocal(match, list, spine, globals);
+    for (; getTerm(cell) == getBody(getBody(consCase));
+            cell = evaluateLocal(match, list, spine, globals)) {
+        Hold* head = evaluateLocal(force, getListElement(getLocals(cell), 1),
+            spine, globals);
+        writeByte(head);
+        release(head);
+        release(list);
+        list = hold(writeString(getListElement(getLocals(cell), 0)));
+        release(cell);
+    }
+    if (getTerm(cell) != nilCase)
+        runtimeError("expected list output from", cell);
+    release(list);
+    release(force);
+    release(match);
+    return cell;
+}
+
+Hold* evaluateTerm(Term* term, Array* globals, const Code* code) {
+    // debug builds report where evaluation was interrupted and then put
+    // back the handler that flushes stdout, see main
+    void (*handler)(int) = SIG_DFL;
+    (void)interrupt, (void)handler;
+    CODE = code;
+    if (MEMORY_LIMIT / 2 < CONSTANT_MEMORY_LIMIT)
+        CONSTANT_MEMORY_LIMIT = MEMORY_LIMIT / 2;
+    CONSTANTS = (Hold**)calloc(length(globals), sizeof(Hold*));
+    FILLED = (size_t*)calloc(length(globals), sizeof(size_t));
+    if (CONSTANTS == NULL || FILLED == NULL)
+        error("\nError: out of memory\n");
+    Spine* spine = newSpine(1024);
+    UNPACKED = newArray(16);
+    MEMORY_LIMIT_HANDLER = exceedMemoryLimit;
+    assert((handler = signal(SIGINT, interrupt)) != SIG_ERR);
+    Hold* result = isIO ? writeOutput(term, spine, globals) :
+        evaluateValue(term, spine, globals);
+    assert(signal(SIGINT, handler) != SIG_ERR);
+    MEMORY_LIMIT_HANDLER = NULL;
+    PROFILED(enterSite(NULL));
+    deleteSpine(spine);
+    deleteInput();
+    releaseConstants();
+    free(CONSTANTS);
+    free(FILLED);
+    repackStrings();
+    deleteArray(UNPACKED);
+    releaseSharedNodes();
+    release((Hold*)EXPANSION_TAG);
+    EXPANSION_TAG = NULL;
     return result;
 }
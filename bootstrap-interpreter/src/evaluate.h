@@ -1 +1,2 @@
-Hold* evaluateTerm(Term* term, Array* globals);
+Hold* evaluateTerm(Term* term, Array* globals, const Code* code);
+void releaseConstants(void);
@@ -18,6 +18,7 @@ static void printBacktrace(Closure* closure) {
 }
 
 void printRuntimeError(const char* message, Closure* closure) {
+    fflush(stdout);
     if (TRACE && !isEmpty((Stack*)getBacktrace(closure)))
         printBacktrace(closure);
     fputs("\nRuntime error: ", stderr);
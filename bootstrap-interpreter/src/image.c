@@ -0,0 +1,510 @@
+#define _DEFAULT_SOURCE  // mmap
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "tree.h"
+#include "array.h"
+#include "parse/ast.h"
+#include "parse/term.h"
+#include "parse/parse.h"
+#include "image.h"
+
+extern bool isIO;
+extern Term *TRUE, *FALSE;
+
+// an image is a header followed by the offsets of the filenames in the text,
+// the tags, the nodes in the order they were built, the indexes of the
+// globals and of the syntax definitions, and the text of the tags and
+// filenames. nodes and tags refer to each other by 1-based index, where 0 is
+// NULL, so images can be mapped anywhere, but they are only read by builds
+// for the same platform
+static const char MAGIC[8] = "zimage3";
+
+typedef struct {
+    char magic[8];
+    uint32_t fileCount, tagCount, nodeCount, globalCount, syntaxCount;
+    uint32_t root, trueTerm, falseTerm, isIO;
+    uint64_t textSize;
+} Header;
+
+typedef struct {
+    uint64_t text;
+    uint16_t length, file, line, column;
+    char fixity, prefix;
+} TagRecord;
+
+typedef struct {
+    uint64_t first, second;     // children, or the value of a leaf
+    uint32_t tag;
+    char isBranch, type, variety;
+} NodeRecord;
+
+typedef struct {
+    const void* key;
+    uint32_t index, length;
+} Entry;
+
+typedef struct {
+    Entry* entries;
+    size_t count, capacity;
+} Map;
+
+typedef struct {
+    Map nodes, tags, texts;
+    NodeRecord* nodeRecords;
+    TagRecord* tagRecords;
+    char* text;
+    size_t nodeCount, nodeCapacity, tagCount, tagCapacity;
+    size_t textSize, textCapacity;
+} Writer;
+
+static char* IMAGE = NULL;      // mapped image, which holds the tag text
+static size_t IMAGE_SIZE = 0;
+
+static void* grow(void* elements, size_t* capacity, size_t count,
+        size_t size) {
+    if (count < *capacity)
+        return elements;
+    *capacity = *capacity == 0 ? 1024 : 2 * *capacity;
+    elements = realloc(elements, *capacity * size);
+    return elements == NULL ? error("\nError: out of memory\n") : elements;
+}
+
+static Entry* findEntry(const Map* map, const void* key) {
+    unsigned long long hash = (unsigned long long)(uintptr_t)key;
+    hash = (hash ^ (hash >> 17)) * 0x9E3779B97F4A7C15ull;
+    size_t i = (size_t)(hash >> 32) & (map->capacity - 1);
+    while (map->entries[i].key != key && map->entries[i].key != NULL)
+        i = (i + 1) & (map->capacity - 1);
+    return &map->entries[i];
+}
+
+static void resizeMap(Map* map, size_t capacity) {
+    Entry* entries = map->entries;
+    size_t oldCapacity = map->capacity;
+    map->entries = (Entry*)calloc(capacity, sizeof(Entry));
+    if (map->entries == NULL)
+        error("\nError: out of memory\n");
+    map->capacity = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i)
+        if (entries[i].key != NULL)
+            *findEntry(map, entries[i].key) = entries[i];
+    free(entries);
+}
+
+static Entry* addEntry(Map* map, const void* key) {
+    if (2 * (map->count + 1) > map->capacity)
+        resizeMap(map, 2 * map->capacity);
+    Entry* entry = findEntry(map, key);
+    if (entry->key == NULL) {
+        entry->key = key;
+        map->count += 1;
+    }
+    return entry;
+}
+
+static uint64_t writeText(Writer* writer, const char* text, size_t length) {
+    // the text of interned tags is shared, but some tags with the same start
+    // have different lengths, so the text is written again if it is longer
+    Entry* entry = addEntry(&writer->texts, text);
+    if (entry->index > 0 && entry->length >= length)
+        return entry->index - 1;
+    entry->index = (uint32_t)writer->textSize + 1;
+    entry->length = (uint32_t)length;
+    for (size_t i = 0; i <= length; ++i) {
+        writer->text = (char*)grow(writer->text, &writer->textCapacity,
+            writer->textSize, sizeof(char));
+        writer->text[writer->textSize++] = i < length ? text[i] : '\0';
+    }
+    return entry->index - 1;
+}
+
+static uint32_t writeTag(Writer* writer, Tag tag) {
+    if (tag == NULL)
+        return 0;
+    Entry* entry = findEntry(&writer->tags, tag);
+    if (entry->key != NULL)
+        return entry->index;
+    Lexeme lexeme = getLexeme(tag);
+    writer->tagRecords = (TagRecord*)grow(writer->tagRecords,
+        &writer->tagCapacity, writer->tagCount, sizeof(TagRecord));
+    writer->tagRecords[writer->tagCount++] = (TagRecord){
+        writeText(writer, lexeme.start, lexeme.length), lexeme.length,
+        lexeme.location.file, lexeme.location.line, lexeme.location.column,
+        getTagFixity(tag), getVariety((Node*)tag)};
+    addEntry(&writer->tags, tag)->index = (uint32_t)writer->tagCount;
+    return (uint32_t)writer->tagCount;
+}
+
+static uint32_t writeNode(Writer* writer, Node* node) {
+    // children are written first, so a node only refers to earlier nodes
+    if (node == NULL)
+        return 0;
+    Entry* entry = findEntry(&writer->nodes, node);
+    if (entry->key != NULL)
+        return entry->index;
+    NodeRecord record = {0, 0, writeTag(writer, getTag(node)),
+        isBranch(node), getType(node), getVariety(node)};
+    if (record.isBranch) {
+        record.first = writeNode(writer, getLeft(node));
+        record.second = writeNode(writer, getRight(node));
+    } else if (getType(node) == PACKEDSTRING) {
+        const char* bytes = getData(node);
+        record.first = writeText(writer, bytes, strlen(bytes));
+    } else {
+        record.first = (uint64_t)getValue(node);
+    }
+    writer->nodeRecords = (NodeRecord*)grow(writer->nodeRecords,
+        &writer->nodeCapacity, writer->nodeCount, sizeof(NodeRecord));
+    writer->nodeRecords[writer->nodeCount++] = record;
+    addEntry(&writer->nodes, node)->index = (uint32_t)writer->nodeCount;
+    return (uint32_t)writer->nodeCount;
+}
+
+static uint32_t findNode(Writer* writer, Node* node) {
+    return node == NULL ? 0 : findEntry(&writer->nodes, node)->index;
+}
+
+static void writeSection(const void* data, size_t size, FILE* stream) {
+    if (size > 0 && fwrite(data, size, 1, stream) != 1)
+        error("\nError: cannot write image\n");
+}
+
+void saveImage(Program program, FILE* stream) {
+    Writer writer = {0};
+    resizeMap(&writer.nodes, 1024);
+    resizeMap(&writer.tags, 1024);
+    resizeMap(&writer.texts, 1024);
+    writeNode(&writer, program.root);
+    size_t syntaxCount = length(program.syntax);
+    uint32_t* syntax = (uint32_t*)smalloc(syntaxCount * sizeof(uint32_t));
+    for (size_t i = 0; i < syntaxCount; ++i)
+        syntax[i] = writeNode(&writer, elementAt(program.syntax, i));
+    unsigned short fileCount = getFileCount();
+    uint64_t* files = (uint64_t*)smalloc(fileCount * sizeof(uint64_t));
+    for (unsigned short i = 0; i < fileCount; ++i) {
+        const char* filename = getFilename((unsigned short)(i + 1));
+        files[i] = writeText(&writer, filename, strcspn(filename, "\n"));
+    }
+    size_t globalCount = length(program.globals);
+    uint32_t* globals = (uint32_t*)smalloc(globalCount * sizeof(uint32_t));
+    for (size_t i = 0; i < globalCount; ++i)
+        globals[i] = findNode(&writer, elementAt(program.globals, i));
+    Header header = {{0}, fileCount, (uint32_t)writer.tagCount,
+        (uint32_t)writer.nodeCount, (uint32_t)globalCount,
+        (uint32_t)syntaxCount, findNode(&writer, program.root),
+        findNode(&writer, TRUE), findNode(&writer, FALSE), isIO,
+        writer.textSize};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    writeSection(&header, sizeof(Header), stream);
+    writeSection(files, fileCount * sizeof(uint64_t), stream);
+    writeSection(writer.tagRecords, writer.tagCount * sizeof(TagRecord),
+        stream);
+    writeSection(writer.nodeRecords, writer.nodeCount * sizeof(NodeRecord),
+        stream);
+    writeSection(globals, globalCount * sizeof(uint32_t), stream);
+    writeSection(syntax, syntaxCount * sizeof(uint32_t), stream);
+    writeSection(writer.text, writer.textSize, stream);
+    free(files);
+    free(globals);
+    free(syntax);
+    free(writer.nodes.entries);
+    free(writer.tags.entries);
+    free(writer.texts.entries);
+    free(writer.nodeRecords);
+    free(writer.tagRecords);
+    free(writer.text);
+}
+
+static void invalidImage(void) {error("\nError: invalid image\n");}
+
+static void checkImage(bool condition) {
+    if (!condition)
+        invalidImage();
+}
+
+static const void* mapImage(FILE* stream) {
+    struct stat status;
+    if (fstat(fileno(stream), &status) != 0 ||
+            (size_t)status.st_size < sizeof(Header))
+        invalidImage();
+    IMAGE_SIZE = (size_t)status.st_size;
+    void* image = mmap(NULL, IMAGE_SIZE, PROT_READ, MAP_PRIVATE,
+        fileno(stream), 0);
+    if (image == MAP_FAILED)
+        invalidImage();
+    return IMAGE = (char*)image;
+}
+
+static size_t skipSection(size_t offset, uint64_t count, size_t size) {
+    // returns the offset past count records of the given size, which must
+    // fit in the image, checked without overflowing
+    checkImage(offset <= IMAGE_SIZE && count <= (IMAGE_SIZE - offset) / size);
+    return offset + (size_t)count * size;
+}
+
+static bool isText(const char* text, uint64_t textSize, uint64_t offset) {
+    // true if a null terminated string starts at the offset in the text
+    return offset < textSize &&
+        memchr(&text[offset], '\0', (size_t)(textSize - offset)) != NULL;
+}
+
+static Tag* loadTags(const TagRecord* records, size_t count,
+        const char* text, uint64_t textSize, uint32_t fileCount) {
+    Tag* tags = (Tag*)smalloc((count + 1) * sizeof(Tag));
+    tags[0] = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        const TagRecord* record = &records[i];
+        checkImage(record->text < textSize &&
+            record->length < textSize - record->text &&
+            record->file <= fileCount);
+        Lexeme lexeme = newLexeme(&text[record->text], record->length,
+            newLocation(record->file, record->line, record->column));
+        tags[i + 1] = (Tag)hold((Node*)newPrefixedTag(lexeme, record->fixity,
+            record->prefix));
+    }
+    return tags;
+}
+
+static Node* loadLeaf(const NodeRecord* record, Tag tag, const char* text,
+        uint64_t textSize) {
+    // the bytes of packed strings are read in place from the image text
+    if (record->type != PACKEDSTRING)
+        return newLeaf(tag, record->type, record->variety,
+            (long long)record->first);
+    checkImage(isText(text, textSize, record->first));
+    return newPointerLeaf(tag, record->type, record->variety,
+        (void*)(uintptr_t)&text[record->first]);
+}
+
+// a node is a valid term if it is within the given depth of abstractions
+// and only refers to globals before the given one, so the globals must have
+// depth 0 and only refer to earlier globals. nodes that can't be terms, such
+// as the parameters of abstractions, which have AST types, can still be in
+// an image as long as no term uses them
+typedef struct {
+    uint64_t depth;
+    uint32_t globals;
+} Bounds;
+
+static const Bounds NOT_TERM = {UINT64_MAX, 0};
+
+static bool isTerm(Bounds bounds) {return bounds.depth != NOT_TERM.depth;}
+
+static Bounds join(Bounds a, Bounds b) {
+    return !isTerm(a) || !isTerm(b) ? NOT_TERM : (Bounds){
+        a.depth > b.depth ? a.depth : b.depth,
+        a.globals > b.globals ? a.globals : b.globals};
+}
+
+static Bounds getBounds(const NodeRecord* records, const Bounds* bounds,
+        uint64_t i, uint32_t globalCount) {
+    const NodeRecord* record = &records[i - 1];
+    Bounds left = record->isBranch ? bounds[record->first] : NOT_TERM;
+    Bounds right = record->isBranch ? bounds[record->second] : NOT_TERM;
+    long long value = (long long)record->first;
+    switch (record->type) {
+        case VARIABLE:
+            if (record->isBranch || value == 0)
+                return NOT_TERM;
+            if (value > 0)
+                return (Bounds){(uint64_t)value, 0};
+            return (uint64_t)-(value + 1) < globalCount ?
+                (Bounds){0, (uint32_t)-value} : NOT_TERM;
+        case ABSTRACTION:
+            return !isTerm(right) || right.depth == 0 ? right :
+                (Bounds){right.depth - 1, right.globals};
+        case APPLICATION: return join(left, right);
+        case NUMERAL: return record->isBranch ? NOT_TERM : (Bounds){0, 0};
+        case OPERATION:
+            if (record->variety <= NONE || record->variety > GET)
+                return NOT_TERM;
+            if (isPseudoOperation((OperationCode)record->variety))
+                return record->isBranch ? NOT_TERM : (Bounds){0, 0};
+            return record->isBranch && record->first == 0 ? right : NOT_TERM;
+        case PACKEDSTRING:
+            // constructors are closed, and the bytes are in a leaf
+            return isTerm(left) && left.depth == 0 &&
+                records[record->first - 1].type == APPLICATION &&
+                record->second > 0 && !records[record->second - 1].isBranch &&
+                records[record->second - 1].type == PACKEDSTRING ?
+                left : NOT_TERM;
+        default: return NOT_TERM;
+    }
+}
+
+static Node** loadNodes(const NodeRecord* records, size_t count,
+        Tag* tags, size_t tagCount, const char* text, uint64_t textSize,
+        Bounds* bounds, uint32_t globalCount) {
+    Node** nodes = (Node**)smalloc((count + 1) * sizeof(Node*));
+    nodes[0] = NULL;
+    bounds[0] = NOT_TERM;
+    for (size_t i = 0; i < count; ++i) {
+        const NodeRecord* record = &records[i];
+        checkImage(record->tag <= tagCount && (!record->isBranch ||
+            (record->first <= i && record->second <= i)));
+        bounds[i + 1] = getBounds(records, bounds, i + 1, globalCount);
+        Tag tag = tags[record->tag];
+        nodes[i + 1] = hold(record->isBranch ?
+            newBranch(tag, record->type, record->variety,
+                nodes[record->first], nodes[record->second]) :
+            loadLeaf(record, tag, text, textSize));
+    }
+    return nodes;
+}
+
+static bool isClosed(Bounds bounds, uint32_t globalCount) {
+    return isTerm(bounds) && bounds.depth == 0 && bounds.globals <= globalCount;
+}
+
+static bool* findReachable(const NodeRecord* records, size_t count,
+        uint32_t root) {
+    // children come before their parents, so one pass down from the root
+    // finds every node that it holds
+    bool* reachable = (bool*)calloc(count + 1, sizeof(bool));
+    if (reachable == NULL)
+        error("\nError: out of memory\n");
+    reachable[root] = true;
+    for (size_t i = count; i > 0; --i) {
+        const NodeRecord* record = &records[i - 1];
+        if (reachable[i] && record->isBranch) {
+            reachable[record->first] = true;
+            reachable[record->second] = true;
+        }
+    }
+    return reachable;
+}
+
+static bool isBranchOf(Node* node, char type) {
+    return node != NULL && isBranch(node) && getType(node) == type;
+}
+
+static bool isLeafOf(Node* node, char type) {
+    return node != NULL && !isBranch(node) && getType(node) == type &&
+        getTag(node) != NULL;
+}
+
+static bool isNamed(Node* node) {
+    return isLeafOf(node, REFERENCE) && isName(node);
+}
+
+static bool isLibrary(Node* root, const Array* globals) {
+    // code linked against an image is bound in the scope of its definitions,
+    // which are applications of abstractions to all but the last global,
+    // with the last global, the entry, in the scope of all of them. the
+    // parameters are only used for their names, and the parameter of main
+    // is also the reference to it in the entry, so it can be bound
+    Node* node = root;
+    for (size_t i = 0; i + 1 < length(globals); ++i) {
+        if (!isBranchOf(node, APPLICATION) ||
+                getRight(node) != elementAt(globals, i) ||
+                !isBranchOf(getLeft(node), ABSTRACTION) ||
+                getParameter(getLeft(node)) == NULL ||
+                getTag(getParameter(getLeft(node))) == NULL)
+            return false;
+        node = getBody(getLeft(node));
+    }
+    return node == elementAt(globals, length(globals) - 1);
+}
+
+static bool isSyntax(Node* node) {
+    // syntax definitions are parsed again when code is linked against an
+    // image, so they must have the shape that the parser gives them
+    if (!isBranchOf(node, DEFINITION) || !isSyntaxDefinition(node) ||
+            getTag(node) == NULL)
+        return false;
+    Node* left = getLeft(node);
+    Node* right = getRight(node);
+    return isBranchOf(left, JUXTAPOSITION) && isNamed(getLeft(left)) &&
+        isThisName(getLeft(left), "syntax") && isNamed(getRight(left)) &&
+        isBranchOf(right, JUXTAPOSITION) && isNamed(getLeft(right)) &&
+        getRight(right) != NULL && getTag(getRight(right)) != NULL;
+}
+
+Program loadImage(FILE* stream) {
+    const char* image = mapImage(stream);
+    const Header* header = (const Header*)image;
+    checkImage(memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0);
+    size_t offset = skipSection(sizeof(Header), header->fileCount,
+        sizeof(uint64_t));
+    offset = skipSection(offset, header->tagCount, sizeof(TagRecord));
+    offset = skipSection(offset, header->nodeCount, sizeof(NodeRecord));
+    offset = skipSection(offset, header->globalCount, sizeof(uint32_t));
+    offset = skipSection(offset, header->syntaxCount, sizeof(uint32_t));
+    checkImage(header->textSize == IMAGE_SIZE - offset);
+    const uint64_t* files = (const uint64_t*)&image[sizeof(Header)];
+    const TagRecord* tagRecords = (const TagRecord*)&files[header->fileCount];
+    const NodeRecord* nodeRecords =
+        (const NodeRecord*)&tagRecords[header->tagCount];
+    const uint32_t* globalIndexes =
+        (const uint32_t*)&nodeRecords[header->nodeCount];
+    const uint32_t* syntaxIndexes = &globalIndexes[header->globalCount];
+    const char* text = (const char*)&syntaxIndexes[header->syntaxCount];
+    checkImage(header->globalCount > 0 &&
+        header->root > 0 && header->root <= header->nodeCount &&
+        header->trueTerm <= header->nodeCount &&
+        header->falseTerm <= header->nodeCount);
+
+    for (uint32_t i = 0; i < header->fileCount; ++i) {
+        // file indexes start at 1, and 0 is no file
+        checkImage(isText(text, header->textSize, files[i]) &&
+            newFilename(&text[files[i]]) == i + 1);
+    }
+    Tag* tags = loadTags(tagRecords, header->tagCount, text,
+        header->textSize, header->fileCount);
+    Bounds* bounds = (Bounds*)smalloc(
+        ((size_t)header->nodeCount + 1) * sizeof(Bounds));
+    Node** nodes = loadNodes(nodeRecords, header->nodeCount, tags,
+        header->tagCount, text, header->textSize, bounds,
+        header->globalCount);
+    // globals and booleans are only held through the root
+    bool* reachable = findReachable(nodeRecords, header->nodeCount,
+        header->root);
+    Array* globals = newArray(header->globalCount);
+    for (uint32_t i = 0; i < header->globalCount; ++i) {
+        checkImage(globalIndexes[i] > 0 &&
+            globalIndexes[i] <= header->nodeCount &&
+            isClosed(bounds[globalIndexes[i]], i) &&
+            reachable[globalIndexes[i]]);
+        append(globals, nodes[globalIndexes[i]]);
+    }
+    checkImage(isClosed(bounds[header->root], header->globalCount) &&
+        (header->trueTerm == 0 || (reachable[header->trueTerm] &&
+        isClosed(bounds[header->trueTerm], header->globalCount))) &&
+        (header->falseTerm == 0 || (reachable[header->falseTerm] &&
+        isClosed(bounds[header->falseTerm], header->globalCount))) &&
+        isLibrary(nodes[header->root], globals));
+    Array* syntax = newArray(header->syntaxCount);
+    for (uint32_t i = 0; i < header->syntaxCount; ++i) {
+        checkImage(syntaxIndexes[i] > 0 &&
+            syntaxIndexes[i] <= header->nodeCount &&
+            isSyntax(nodes[syntaxIndexes[i]]));
+        append(syntax, hold(nodes[syntaxIndexes[i]]));
+    }
+    Hold* root = hold(nodes[header->root]);
+    TRUE = nodes[header->trueTerm];
+    FALSE = nodes[header->falseTerm];
+    isIO = header->isIO;
+    // tags and nodes are held while loading so that any that the program
+    // doesn't use are released here instead of leaking
+    for (uint32_t i = 1; i <= header->nodeCount; ++i)
+        release(nodes[i]);
+    for (uint32_t i = 1; i <= header->tagCount; ++i)
+        release((Hold*)tags[i]);
+    free(tags);
+    free(nodes);
+    free(bounds);
+    free(reachable);
+    return (Program){root, elementAt(globals, length(globals) - 1), globals,
+        syntax};
+}
+
+void unloadImage(void) {
+    if (IMAGE != NULL)
+        munmap(IMAGE, IMAGE_SIZE);
+    IMAGE = NULL;
+    IMAGE_SIZE = 0;
+}
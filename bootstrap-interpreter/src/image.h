@@ -0,0 +1,4 @@
+// images hold a bound program, so that it can be run without parsing
+void saveImage(Program program, FILE* stream);
+Program loadImage(FILE* stream);
+void unloadImage(void);
@@ -1,17 +1,22 @@
+#include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "freelist.h"
 #include "readfile.h"
 #include "util.h"
 #include "tree.h"
+#include "profile.h"
 #include "array.h"
 #include "parse/opp/operator.h"
 #include "parse/term.h"
 #include "parse/parse.h"
 #include "closure.h"
+#include "compile.h"
 #include "evaluate.h"
+#include "image.h"
 
 bool TRACE = false;
+static bool WALK = false;
 extern bool isIO;
 
 static void showTag(Tag tag, FILE* stream) {
@@ -29,8 +34,10 @@ static Hold* resolveLocals(Term* term, Node* locals, unsigned int depth) {
         case VARIABLE: {
             if (isGlobal(term) || getDebruijnIndex(term) <= depth)
                 return hold(term);
-            Closure* closure = getListElement(locals,
-                getDebruijnIndex(term) - depth - 1);
+            // serialize the source of updated closures so that the output
+            // is the same as it would be without sharing
+            Closure* closure = getSource(
+                getListElement(locals, getDebruijnIndex(term) - depth - 1));
             return resolveLocals(getTerm(closure), getLocals(closure), 0);
         } case APPLICATION: {
             Hold* left = resolveLocals(getLeft(term), locals, depth);
@@ -48,6 +55,24 @@ static Hold* resolveLocals(Term* term, Node* locals, unsigned int depth) {
     }
 }
 
+static void showTerm(Term* term, FILE* stream);
+
+static void showPackedString(Term* string, FILE* stream) {
+    // shown as the applications of (::) that it stands for
+    Term* cons = getPackedCons(string);
+    const char* bytes = getPackedBytes(string);
+    for (const char* c = bytes; *c != '\0'; ++c) {
+        fputs(isAbstraction(cons) ? "(" : "", stream);
+        showTerm(cons, stream);
+        fputs(isAbstraction(cons) ? ")(" : "(", stream);
+        fputll((unsigned char)*c, stream);
+        fputs(")(", stream);
+    }
+    showTerm(getPackedNil(string), stream);
+    for (const char* c = bytes; *c != '\0'; ++c)
+        fputs(")", stream);
+}
+
 static void showTerm(Term* term, FILE* stream) {
     switch (getTermType(term)) {
         case APPLICATION:
@@ -68,6 +93,7 @@ static void showTerm(Term* term, FILE* stream) {
         case NUMERAL: fputll(getValue(term), stream); break;
         case VARIABLE: showTag(getTag(term), stream); break;
         case OPERATION: showTag(getTag(term), stream); break;
+        case PACKEDSTRING: showPackedString(term, stream); break;
     }
 }
 
@@ -84,8 +110,21 @@ static void print3(const char* a, const char* b, const char* c) {
     fputs(c, stderr);
 }
 
+#ifdef PROFILE
+#define PROFILE_FLAG " [-H]"
+#else
+#define PROFILE_FLAG ""
+#endif
+#ifdef LATENCY
+#define LATENCY_FLAG " [-T]"
+#else
+#define LATENCY_FLAG ""
+#endif
+
 static void usageError(const char* name) {
-    print3("Usage error: ", name, " [-c] [-p] [-t] [FILE]\n");
+    print3("Usage error: ", name, " [-c] [-p] [-t] [-u] [-w]" PROFILE_FLAG
+        LATENCY_FLAG " [-m LIMIT] [-n NODES] [-L] [-o IMAGE]"
+        " [-i IMAGE] [FILE]\n");
     exit(2);
 }
 
@@ -94,74 +133,179 @@ static void readError(const char* filename) {
     exit(2);
 }
 
+static void writeError(const char* filename) {
+    print3("Error: file '", filename, "' cannot be written\n");
+    exit(1);
+}
+
+static size_t parseSize(const char* size, const char* programName) {
+    // a positive number, optionally followed by k, m or g
+    const char* c = size;
+    size_t n = 0;
+    for (; *c >= '0' && *c <= '9'; ++c)
+        n = 10 * n + (size_t)(*c - '0');
+    switch (*c) {
+        case 'k': n <<= 10; ++c; break;
+        case 'm': n <<= 20; ++c; break;
+        case 'g': n <<= 30; ++c; break;
+        default: break;
+    }
+    if (n == 0 || *c != '\0')
+        usageError(programName);
+    return n;
+}
+
 static void memoryError(const char* label, long long bytes) {
+    fflush(stdout);
     print3("MEMORY LEAK IN \"", label, "\": ");
     fputll(bytes, stderr);
     fputs(" bytes\n", stderr);
+    printMemoryUsage(stderr);
     exit(3);
 }
 
+static size_t getLiveMemoryUsage(void) {
+    // released nodes are only freed when their slots are reused
+    flushReleases();
+    return getMemoryUsage();
+}
+
 static void checkForMemoryLeak(const char* label, size_t expectedUsage) {
-    size_t usage = getMemoryUsage();
+    size_t usage = getLiveMemoryUsage();
     if (usage != expectedUsage)
         memoryError(label, (long long)(usage - expectedUsage));
 }
 
 static void interpret(Program program) {
-    size_t memoryUsageBeforeEvaluate = getMemoryUsage();
-    Hold* valueClosure = evaluateTerm(program.entry, program.globals);
-    size_t memoryUsageBeforeSerialize = getMemoryUsage();
+    // walking the term tree is kept for differential testing of the bytecode
+    Code* code = WALK ? NULL : compile(program.globals);
+    size_t memoryUsageBeforeEvaluate = getLiveMemoryUsage();
+    Hold* valueClosure = evaluateTerm(program.entry, program.globals, code);
+    size_t memoryUsageBeforeSerialize = getLiveMemoryUsage();
     if (!isIO)
         showClosure(valueClosure, stdout);
     checkForMemoryLeak("serialize", memoryUsageBeforeSerialize);
     release(valueClosure);
     checkForMemoryLeak("evaluate", memoryUsageBeforeEvaluate);
+    deleteCode(code);
 }
 
-static char* readSourceCode(const char* filename) {
-    FILE* stream = fopen(filename, "r");
+static FILE* openFile(const char* filename, const char* mode) {
+    FILE* stream = fopen(filename, mode);
     if (stream == NULL)
         readError(filename);
+    return stream;
+}
+
+static char* readSourceCode(const char* filename) {
+    FILE* stream = openFile(filename, "r");
     char* sourceCode = readfile(stream);
     fclose(stream);
     return sourceCode;
 }
 
+static Program loadProgram(const char* filename) {
+    FILE* stream = openFile(filename, "rb");
+    Program program = loadImage(stream);
+    fclose(stream);
+    return program;
+}
+
+static void saveProgram(Program program, const char* filename) {
+    FILE* stream = openFile(filename, "wb");
+    saveImage(program, stream);
+    if (fclose(stream) != 0)
+        writeError(filename);
+}
+
+static void interrupt(int parameter) {
+    // keeps the output written before an interrupt, as it was kept when
+    // stdout was unbuffered, and then lets the signal end the process
+    fflush(stdout);
+    signal(parameter, SIG_DFL);
+    raise(parameter);
+}
+
 int main(int argc, char* argv[]) {
     // note: setbuf(stdin, NULL) will leave unread input in stdin on exit
     // causing the shell to execute it, which is dangerous
-    // note: disabling buffering slows down I/O quite a bit, but it is necessary
-    // for binary protocols like X Windows.
-    setbuf(stdout, NULL);
+    // note: stdout is buffered and flushed before reading input, before
+    // writing to stderr, on exit and on an interrupt, which is enough for
+    // interactive programs. -u disables buffering, which slows down output
+    // quite a bit, but is necessary for binary protocols like X Windows.
     setbuf(stderr, NULL);
+    signal(SIGINT, interrupt);
 
-    enum {INTERPRET, PARSE, CHECK};
+    enum {INTERPRET, PARSE, CHECK, SAVE};
     int mode = INTERPRET;
+    const char *input = NULL, *output = NULL;  // images
     const char* programName = argv[0];
+    size_t pageCapacity = 4096;     // nodes per pool page
+    bool hugePages = false;
     while (--argc > 0 && (*++argv)[0] == '-') {
         for (const char* flag = argv[0] + 1; flag[0] != '\0'; ++flag) {
             switch (flag[0]) {
                 case 'c': mode = CHECK; break;
                 case 'p': mode = PARSE; break;
                 case 't': TRACE = true; break;
+                case 'u': setbuf(stdout, NULL); break;
+                case 'w': WALK = true; break;
+#ifdef PROFILE
+                case 'H': PROFILING = true; break;
+#endif
+#ifdef LATENCY
+                case 'T': TIMING = true; break;
+#endif
+                case 'L': hugePages = true; break;
+                case 'm':
+                    if (--argc == 0)
+                        usageError(programName);
+                    MEMORY_LIMIT = parseSize(*++argv, programName);
+                    break;
+                case 'n':
+                    if (--argc == 0)
+                        usageError(programName);
+                    pageCapacity = parseSize(*++argv, programName);
+                    break;
+                case 'i':
+                    if (--argc == 0)
+                        usageError(programName);
+                    input = *++argv;
+                    break;
+                case 'o':
+                    if (--argc == 0)
+                        usageError(programName);
+                    output = *++argv;
+                    break;
                 default: usageError(programName); break;
             }
         }
     }
     if (argc > 1)
         usageError(programName);
-    char* sourceCode = argc == 0 ? readfile(stdin) : readSourceCode(argv[0]);
+    mode = output != NULL ? SAVE : mode;
+    char* sourceCode = input != NULL && argc == 0 ? NULL :
+        argc == 0 ? readfile(stdin) : readSourceCode(argv[0]);
 
-    initNodeAllocator();
-    Program program = parse(sourceCode);
+    // an image is run as it is, or source code is linked against it so that
+    // the code can use its definitions and syntax without parsing them
+    initNodeAllocator(pageCapacity, hugePages);
+    Program library = input != NULL ? loadProgram(input) :
+        (Program){NULL, NULL, NULL, NULL};
+    Program program = sourceCode == NULL ? library :
+        parse(sourceCode, library);
     switch (mode) {
         case INTERPRET: interpret(program); break;
         case PARSE: showTerm(program.root, stdout); fputs("\n", stdout); break;
         case CHECK: break;
+        case SAVE: saveProgram(program, output); break;
     }
     deleteProgram(program);
     checkForMemoryLeak("parse", 0);
+    fflush(stdout);     // the allocator may report to stderr
     destroyNodeAllocator();
+    deleteSymbols();
+    unloadImage();
     free(sourceCode);
     return 0;
 }
@@ -1,9 +1,10 @@
 #include <stdlib.h>     // exit
 #include <stdio.h>      // fputs
 #include <limits.h>     // LLONG_MAX
+#include <string.h>     // memmove
 #include "util.h"       // error
 #include "tree.h"
-#include "stack.h"
+#include "input.h"
 #include "array.h"
 #include "parse/term.h"
 #include "closure.h"
@@ -11,12 +12,12 @@
 #include "operations.h"
 
 static bool STDERR = false;
-Stack* INPUT_STACK;
 extern Term *TRUE, *FALSE;
 
 static Term* Boolean(bool value) {return value ? TRUE : FALSE;}
 
 static void operationError(const char* message) {
+    fflush(stdout);
     fputs("\nRuntime error: ", stderr);
     fputs(message, stderr);
     fputs("\n", stderr);
@@ -62,6 +63,8 @@ static long long getNumericValue(Term* operation, Term* numeral) {
 }
 
 static Hold* evaluateAbort(Closure* operation, Closure* message) {
+    // the message follows the output so far
+    fflush(stdout);
     if (TRACE) {
         printRuntimeError("hit", operation);
         fputc((int)'\n', stderr);
@@ -75,43 +78,128 @@ static Term* evaluatePut(Closure* operation, Term* left) {
     if (c >= 0 && c < 256)
         fputc((int)c, STDERR ? stderr : stdout);
     Tag tag = getTag(getTerm(operation));
-    return Abstraction(tag, Variable(tag, 1));
+    return SharedAbstraction(tag, SharedVariable(tag, 1));
+}
+
+// terms read from the input are kept in chunks, so that any index can be
+// read again in constant time. a chunk is released once none of its terms is
+// referenced from outside the buffer, since then no (get) term can reach it
+#define INPUT_CHUNK_SIZE 4096
+typedef Hold* InputChunk[INPUT_CHUNK_SIZE];
+static InputChunk** INPUT = NULL;
+static size_t INPUT_CHUNKS = 0, INPUT_CAPACITY = 0, FIRST_CHUNK = 0;
+static long long INPUT_LENGTH = 0;
+
+static Term* getInput(long long index) {
+    size_t chunk = (size_t)(index / INPUT_CHUNK_SIZE);
+    assert(chunk >= FIRST_CHUNK);
+    return (*INPUT[chunk - FIRST_CHUNK])[index % INPUT_CHUNK_SIZE];
+}
+
+static bool isReachable(Term* term) {
+    // the term for index n is ((::) c get(n + 1, globals)), so index n + 1
+    // can only be read again through a reference to one of these parts
+    return getReferenceCount(term) > 1 ||
+        getReferenceCount(getRight(term)) > 1 ||
+        getReferenceCount(getLeft(getRight(term))) > 1;
+}
+
+static void releaseChunk(InputChunk* chunk) {
+    for (size_t i = 0; i < INPUT_CHUNK_SIZE; ++i)
+        release((*chunk)[i]);
+    free(chunk);
+}
+
+static bool isReleasable(InputChunk* chunk) {
+    for (size_t i = 0; i < INPUT_CHUNK_SIZE; ++i)
+        if (isReachable((*chunk)[i]))
+            return false;
+    return true;
+}
+
+static void releaseInput(void) {
+    size_t released = 0;
+    while (released < INPUT_CHUNKS && isReleasable(INPUT[released]))
+        releaseChunk(INPUT[released++]);
+    if (released == 0)
+        return;
+    INPUT_CHUNKS -= released;
+    FIRST_CHUNK += released;
+    memmove(INPUT, &INPUT[released], INPUT_CHUNKS * sizeof(InputChunk*));
+}
+
+static void appendInput(Term* term) {
+    size_t offset = (size_t)(INPUT_LENGTH % INPUT_CHUNK_SIZE);
+    if (offset == 0) {
+        releaseInput();
+        if (INPUT_CHUNKS == INPUT_CAPACITY) {
+            INPUT_CAPACITY = INPUT_CAPACITY == 0 ? 16 : 2 * INPUT_CAPACITY;
+            INPUT = (InputChunk**)realloc(INPUT,
+                INPUT_CAPACITY * sizeof(InputChunk*));
+            if (INPUT == NULL)
+                error("\nError: out of memory\n");
+        }
+        INPUT[INPUT_CHUNKS++] = (InputChunk*)smalloc(sizeof(InputChunk));
+    }
+    (*INPUT[INPUT_CHUNKS - 1])[offset] = hold(term);
+    INPUT_LENGTH += 1;
+}
+
+void deleteInput(void) {
+    size_t last = (size_t)(INPUT_LENGTH % INPUT_CHUNK_SIZE);
+    for (size_t i = 0; i < INPUT_CHUNKS; ++i) {
+        InputChunk* chunk = INPUT[i];
+        size_t count = i + 1 < INPUT_CHUNKS || last == 0 ?
+            INPUT_CHUNK_SIZE : last;
+        for (size_t j = 0; j < count; ++j)
+            release((*chunk)[j]);
+        free(chunk);
+    }
+    free(INPUT);
+    INPUT = NULL;
+    INPUT_CHUNKS = INPUT_CAPACITY = FIRST_CHUNK = 0;
+    INPUT_LENGTH = 0;
+    closeInput();
 }
 
 static Term* evaluateGet(Closure* operation, Term* left, Term* right) {
-    static long long inputIndex = 0;
     long long index = getNumericValue(operation, left);
-    assert(index <= inputIndex);
-    if (index < inputIndex)
-        return peek(INPUT_STACK, (size_t)(inputIndex - index - 1));
-    inputIndex += 1;
-    int c = fgetc(stdin);
+    assert(index <= INPUT_LENGTH);
+    if (index < INPUT_LENGTH)
+        return getInput(index);
+    // the program may wait for input, so return the memory it no longer uses
+    // and show the output that it may be waiting on
+    if (!isInputReady()) {
+        releaseFreeMemory();
+        fflush(stdout);
+    }
+    int c = readInput();
     if (c == EOF) {
         Term* nilGlobal = getRight(getLeft(getBody(right)));
-        push(INPUT_STACK, nilGlobal);
+        appendInput(nilGlobal);
     } else {
-        // push ((::) c get(n + 1, globals))
+        // append ((::) c get(n + 1, globals))
         Tag tag = getTag(getTerm(operation));
         Term* prependGlobal = getRight(getBody(right));
-        Term* nextIndex = Numeral(tag, index + 1);
+        Term* nextIndex = UntaggedNumeral(index + 1);
         Term* getIndex = Application(tag, getTerm(operation), nextIndex);
         Term* tail = Application(tag, getIndex, right);
-        Term* prependC = Application(tag, prependGlobal, Numeral(tag, c));
-        push(INPUT_STACK, Application(tag, prependC, tail));
+        Term* prependC = SharedApplication(tag, prependGlobal,
+            SharedNumeral(c));
+        appendInput(Application(tag, prependC, tail));
     }
-    return peek(INPUT_STACK, 0);
+    return getInput(index);
 }
 
 static Term* computeOperation(Closure* operation,
         long long left, long long right) {
-    Tag tag = getTag(getTerm(operation));
     switch (getOperationCode(getTerm(operation))) {
-        case INCREMENT: return Numeral(tag, increment(left));
-        case PLUS: return Numeral(tag, add(left, right));
-        case MONUS: return Numeral(tag, right >= left ? 0 : left - right);
-        case TIMES: return Numeral(tag, multiply(left, right));
-        case DIVIDE: return Numeral(tag, right == 0 ? 0 : left / right);
-        case MODULO: return Numeral(tag, right == 0 ? left : left % right);
+        case INCREMENT: return UntaggedNumeral(increment(left));
+        case PLUS: return UntaggedNumeral(add(left, right));
+        case MONUS: return UntaggedNumeral(right >= left ? 0 : left - right);
+        case TIMES: return UntaggedNumeral(multiply(left, right));
+        case DIVIDE: return UntaggedNumeral(right == 0 ? 0 : left / right);
+        case MODULO: return UntaggedNumeral(right == 0 ? left : left % right);
         case EQUAL: return Boolean(left == right);
         case NOTEQUAL: return Boolean(left != right);
         case LESSTHAN: return Boolean(left < right);
@@ -123,7 +211,10 @@ static Term* computeOperation(Closure* operation,
 }
 
 static Hold* makeResult(Closure* operation, Term* node) {
-    return hold(newClosure(node, NULL, getTrace(operation)));
+    // the operation closure has no locals, so the result can take its place
+    // instead of allocating a new closure
+    setTerm(operation, node);
+    return hold(operation);
 }
 
 static Hold* evaluateOperator(Closure* operation, Term* left, Term* right) {
@@ -1,3 +1,3 @@
-extern Stack* INPUT_STACK;
+void deleteInput(void);
 unsigned int getArity(Term* operation);
 Hold* evaluateOperationTerm(Closure* operation, Closure* left, Closure* right);
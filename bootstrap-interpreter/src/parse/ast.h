@@ -1,5 +1,6 @@
 typedef enum {OPERATOR=0, REFERENCE, ARROW, JUXTAPOSITION, NUMBER, LET,
-    DEFINITION, ASPATTERN, COMMAPAIR, COLONPAIR, SETBUILDER} ASTType;
+    DEFINITION, ASPATTERN, COMMAPAIR, COLONPAIR, SETBUILDER, STRINGLITERAL}
+    ASTType;
 typedef enum {SINGLE, EXPLICITCASE, DEFAULTCASE} ArrowVariety;
 typedef enum {PLAINDEFINITION, MAYBEDEFINITION, TRYDEFINITION,
     SYNTAXDEFINITION, ADTDEFINITION, BINDDEFINITION, TRYBINDDEFINITION}
@@ -20,6 +21,9 @@ static inline bool isAsPattern(Node* n) {return getASTType(n) == ASPATTERN;}
 static inline bool isCommaPair(Node* n) {return getASTType(n) == COMMAPAIR;}
 static inline bool isColonPair(Node* n) {return getASTType(n) == COLONPAIR;}
 static inline bool isSetBuilder(Node* n) {return getASTType(n) == SETBUILDER;}
+static inline bool isStringLiteral(Node* n) {
+    return getASTType(n) == STRINGLITERAL;
+}
 
 static inline bool isDefaultCase(Node* n) {
     return getASTType(n) == ARROW && getVariety(n) == DEFAULTCASE;
@@ -104,6 +108,13 @@ static inline Node* Number(Tag tag, long long n) {
     return newLeaf(tag, NUMBER, 0, n);
 }
 
+// a string literal holds its constructors, ((::) []), and its bytes, which
+// are bound along with it into a packed string, see term.h
+static inline Node* StringLiteral(Tag tag, Node* constructors, char* bytes) {
+    return newBranch(tag, STRINGLITERAL, 0, constructors,
+        newPointerLeaf(NULL, STRINGLITERAL, 0, bytes));
+}
+
 static inline Node* Definition(Tag tag, DefinitionVariety variety,
         Node* left, Node* right) {
     return newBranch(tag, DEFINITION, (char)variety, left, right);
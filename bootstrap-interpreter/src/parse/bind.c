@@ -1,3 +1,6 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "util.h"
 #include "tree.h"
 #include "array.h"
 #include "ast.h"
@@ -8,17 +11,102 @@ extern bool isIO, TRACE;
 bool INLINE = true;
 Term *TRUE = NULL, *FALSE = NULL;
 
-static unsigned long long findDebruijnIndex(Node* name, Array* parameters) {
+// scopes map each name to the position of its innermost binding among the
+// globals and locals, and each position to the one it shadows, so that
+// references are resolved without scanning the bindings
+typedef struct {
+    Tag tag;
+    size_t position;        // 1-based, or 0 when the name is out of scope
+} Binding;
+
+typedef struct {
+    Array* parameters;      // names of globals and locals
+    size_t* shadowed;       // earlier position of the name at each position
+    size_t shadowedCapacity;
+    Binding* bindings;      // hash table with an entry for each name
+    size_t bindingCount, bindingCapacity;
+} Scope;
+
+static size_t hashTag(const Scope* scope, Tag tag) {
+    // tags are interned, so equal tags have the same lexeme start
+    unsigned long long hash = (uintptr_t)getLexeme(tag).start;
+    hash = (hash ^ (hash >> 17)) * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 32) & (scope->bindingCapacity - 1);
+}
+
+static Binding* findBinding(const Scope* scope, Tag tag) {
+    size_t i = hashTag(scope, tag);
+    while (scope->bindings[i].tag != NULL &&
+            !isSameTag(scope->bindings[i].tag, tag))
+        i = (i + 1) & (scope->bindingCapacity - 1);
+    return &scope->bindings[i];
+}
+
+static void resizeBindings(Scope* scope, size_t capacity) {
+    Binding* bindings = scope->bindings;
+    size_t oldCapacity = scope->bindingCapacity;
+    scope->bindings = (Binding*)calloc(capacity, sizeof(Binding));
+    if (scope->bindings == NULL)
+        error("\nError: out of memory\n");
+    scope->bindingCapacity = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i)
+        if (bindings[i].tag != NULL)
+            *findBinding(scope, bindings[i].tag) = bindings[i];
+    free(bindings);
+}
+
+static Scope newScope(void) {
+    Scope scope = {newArray(2048), NULL, 0, NULL, 0, 0};
+    resizeBindings(&scope, 2048);
+    return scope;
+}
+
+static void deleteScope(Scope* scope) {
+    deleteArray(scope->parameters);
+    free(scope->shadowed);
+    free(scope->bindings);
+}
+
+static size_t getDepth(const Scope* scope) {
+    return length(scope->parameters);
+}
+
+static void pushBinding(Scope* scope, Node* parameter) {
+    if (2 * (scope->bindingCount + 1) > scope->bindingCapacity)
+        resizeBindings(scope, 2 * scope->bindingCapacity);
+    Binding* binding = findBinding(scope, getTag(parameter));
+    if (binding->tag == NULL) {
+        *binding = (Binding){getTag(parameter), 0};
+        scope->bindingCount += 1;
+    }
+    append(scope->parameters, parameter);
+    size_t position = getDepth(scope);
+    if (position >= scope->shadowedCapacity) {
+        scope->shadowedCapacity = 2 * position;
+        scope->shadowed = (size_t*)realloc(scope->shadowed,
+            scope->shadowedCapacity * sizeof(size_t));
+        if (scope->shadowed == NULL)
+            error("\nError: out of memory\n");
+    }
+    scope->shadowed[position] = binding->position;
+    binding->position = position;
+}
+
+static void popBinding(Scope* scope) {
+    size_t position = getDepth(scope);
+    Node* parameter = unappend(scope->parameters);
+    findBinding(scope, getTag(parameter))->position =
+        scope->shadowed[position];
+}
+
+static unsigned long long findDebruijnIndex(Node* name, const Scope* scope) {
     syntaxErrorNodeIf(isUnused(name),
         "cannot reference a symbol starting with underscore", name);
-    for (size_t i = 1; i <= length(parameters); ++i) {
-        Node* parameter = elementAt(parameters, length(parameters) - i);
-        if (isSameTag(getTag(parameter), getTag(name))) {
-            syntaxErrorNodeIf(isForbidden(name), "cannot reference", name);
-            return (unsigned long long)i;
-        }
-    }
-    return 0;
+    size_t position = findBinding(scope, getTag(name))->position;
+    if (position == 0)
+        return 0;
+    syntaxErrorNodeIf(isForbidden(name), "cannot reference", name);
+    return (unsigned long long)(getDepth(scope) - position + 1);
 }
 
 static OperationCode findOperationCode(Node* name) {
@@ -28,7 +116,8 @@ static OperationCode findOperationCode(Node* name) {
     return NONE;
 }
 
-static void bindReference(Node* node, Array* parameters, size_t globalDepth) {
+static void bindReference(Node* node, const Scope* scope,
+        size_t globalDepth) {
     OperationCode operationCode = findOperationCode(node);
     if (isPseudoOperation(operationCode)) {
         setType(node, OPERATION);
@@ -36,40 +125,52 @@ static void bindReference(Node* node, Array* parameters, size_t globalDepth) {
         return;
     }
     unsigned long long i = (unsigned long long)getValue(node);
-    unsigned long long index = i > 0 ? i : findDebruijnIndex(node, parameters);
+    unsigned long long index = i > 0 ? i : findDebruijnIndex(node, scope);
     syntaxErrorNodeIf(index == 0, "undefined symbol", node);
-    unsigned long long localDepth = length(parameters) - globalDepth;
+    unsigned long long localDepth = getDepth(scope) - globalDepth;
     long long debruijn = (long long)(index <= localDepth ? index :
-        index - length(parameters) - 1);
+        index - getDepth(scope) - 1);
     setType(node, VARIABLE);
     setValue(node, debruijn);
 }
 
-static void bindWith(Node* node, Array* parameters, const Array* globals) {
+static bool isInlined(Node* node, const Array* globals) {
+    // globals defined by applications are not inlined so that the evaluator
+    // can share their values across references
+    return INLINE && isGlobal(node) &&
+        !isApplication(getGlobalReferent(node, globals));
+}
+
+static void bindWith(Node* node, Scope* scope, const Array* globals) {
     switch (getASTType(node)) {
         case REFERENCE:
-            bindReference(node, parameters, length(globals)); break;
+            bindReference(node, scope, length(globals)); break;
         case ARROW:
-            append(parameters, getParameter(node));
-            bindWith(getBody(node), parameters, globals);
-            unappend(parameters);
+            pushBinding(scope, getParameter(node));
+            bindWith(getBody(node), scope, globals);
+            popBinding(scope);
             setTag(node, getTag(getParameter(node)));
             setType(node, ABSTRACTION);
-            if (INLINE && isGlobal(getBody(node)))
+            if (isInlined(getBody(node), globals))
                 setBody(node, getGlobalReferent(getBody(node), globals));
             break;
         case JUXTAPOSITION:
         case LET:
-            bindWith(getLeft(node), parameters, globals);
-            bindWith(getRight(node), parameters, globals);
+            bindWith(getLeft(node), scope, globals);
+            bindWith(getRight(node), scope, globals);
             setType(node, APPLICATION);
-            if (INLINE && isGlobal(getLeft(node)))
+            if (isInlined(getLeft(node), globals))
                 setLeft(node, getGlobalReferent(getLeft(node), globals));
-            if (INLINE && isGlobal(getRight(node)))
+            if (isInlined(getRight(node), globals))
                 setRight(node, getGlobalReferent(getRight(node), globals));
             break;
         case NUMBER:
             setType(node, NUMERAL); break;
+        case STRINGLITERAL:
+            bindWith(getLeft(node), scope, globals);
+            setType(getRight(node), PACKEDSTRING);
+            setType(node, PACKEDSTRING);
+            break;
         case DEFINITION:
             syntaxErrorNode("missing scope for definition", node); break;
         case ASPATTERN:
@@ -85,16 +186,24 @@ static void bindWith(Node* node, Array* parameters, const Array* globals) {
     }
 }
 
-Array* bind(Hold* root) {
+Array* bind(Hold* root, Node* library, const Array* libraryGlobals) {
     INLINE = isIO && !TRACE;
     Node* node = root;
-    Array* parameters = newArray(2048);         // names of globals and locals
+    Scope scope = newScope();
     Array* globals = newArray(2048);            // values of globals
+    // the definitions of a library are globals of the code linked against
+    // it, but not its entry
+    for (size_t i = 0; library != NULL && i + 1 < length(libraryGlobals);
+            ++i) {
+        pushBinding(&scope, getParameter(getLeft(library)));
+        append(globals, elementAt(libraryGlobals, i));
+        library = getBody(getLeft(library));
+    }
     while (isLet(node) && !isUnderscore(getParameter(getLeft(node)))) {
         Node* definiendum = getParameter(getLeft(node));
         Node* definiens = getRight(node);
         Tag tag = getTag(definiendum);
-        bindWith(definiens, parameters, globals);
+        bindWith(definiens, &scope, globals);
         OperationCode code = findOperationCode(definiendum);
         if (code != NONE && !isPseudoOperation(code)) {
             syntaxErrorIf(!TRUE || !FALSE, "must define booleans before", tag);
@@ -103,15 +212,15 @@ Array* bind(Hold* root) {
             TRUE = definiens;
         else if (FALSE == NULL && isThisTag(tag, "False"))
             FALSE = definiens;
-        append(parameters, definiendum);
+        pushBinding(&scope, definiendum);
         append(globals, getRight(node));
         setType(node, APPLICATION);
         setType(getLeft(node), ABSTRACTION);
         setTag(getLeft(node), tag);
         node = getBody(getLeft(node));
     }
-    bindWith(node, parameters, globals);
-    deleteArray(parameters);
+    bindWith(node, &scope, globals);
+    deleteScope(&scope);
     append(globals, node);
     return globals;
 }
@@ -1 +1 @@
-Array* bind(Hold* root);
+Array* bind(Hold* root, Node* library, const Array* libraryGlobals);
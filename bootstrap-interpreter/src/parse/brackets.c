@@ -6,9 +6,12 @@
 
 Node* Nil(Tag tag) {return FixedName(tag, "[]");}
 
+Node* Cons(Tag tag) {
+    return Name(newLiteralTag("::", getLexeme(tag).location, INFIX));
+}
+
 Node* prepend(Tag tag, Node* item, Node* list) {
-    return Juxtaposition(tag, Juxtaposition(tag,
-        Name(newLiteralTag("::", getLexeme(tag).location, INFIX)), item), list);
+    return Juxtaposition(tag, Juxtaposition(tag, Cons(tag), item), list);
 }
 
 static unsigned short getCommaListLength(Node* node) {
@@ -1,4 +1,5 @@
 Node* Nil(Tag tag);
+Node* Cons(Tag tag);
 Node* prepend(Tag tag, Node* item, Node* list);
 
 Node* reduceOpenParenthesis(Tag tag, Node* before, Node* contents);
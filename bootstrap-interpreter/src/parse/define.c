@@ -59,13 +59,13 @@ Node* Printer(Tag tag) {
 static Node* newMainCall(Node* name) {
     isIO = true;
     Tag tag = getTag(name);
-    Node* print = Printer(tag);
     Node* get = FixedName(tag, "(get)");
     Node* get0 = Juxtaposition(tag, get, Number(tag, 0));
     Node* operators = newChurchPair(tag, FixedName(tag, "[]"),
         Name(newLiteralTag("::", getLexeme(tag).location, INFIX)));
     Node* input = Juxtaposition(tag, get0, operators);
-    return Juxtaposition(tag, print, Juxtaposition(tag, name, input));
+    // the result is written by the evaluator, see writeOutput
+    return Juxtaposition(tag, name, input);
 }
 
 static bool containsFreeName(Node* node, Node* name) {
@@ -79,6 +79,8 @@ static bool containsFreeName(Node* node, Node* name) {
         case JUXTAPOSITION:
             return containsFreeName(getLeft(node), name)
                 || containsFreeName(getRight(node), name);
+        case STRINGLITERAL:
+            return containsFreeName(getLeft(node), name);
         case NUMBER:
             return false;
         default:
@@ -1,11 +1,12 @@
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "array.h"
 #include "tree.h"
 #include "util.h"
+#include "freelist.h"
 #include "operator.h"
 
-static Array* SYNTAX = NULL;     // note: this never gets free'd
-
 typedef struct Syntax Syntax;
 
 struct Syntax {
@@ -16,8 +17,22 @@ struct Syntax {
     Associativity associativity;
     bool special;
     Reducer reduce;
+    Syntax* shadowed;   // syntax of the same name in the enclosing scope
 };
 
+// each name maps to its innermost syntax, which links to the syntax it
+// shadows, so that both lookup and leaving a scope take constant time.
+// names stay in the table when their syntax goes out of scope
+typedef struct {
+    Lexeme lexeme;
+    Syntax* syntax;
+} SyntaxEntry;
+
+static SyntaxEntry* ENTRIES = NULL;
+static size_t ENTRY_COUNT = 0, ENTRY_CAPACITY = 0;
+static Array* SCOPE = NULL;     // syntax in scope, innermost last
+static Array* SYNTAX = NULL;    // all syntax, which operators may refer to
+
 static inline Node* Operator(Tag tag, long long subprecedence, void* syntax) {
     syntaxErrorIf(subprecedence >= 256, "indent too big", tag);
     return newPointerLeaf(tag, 0, (char)subprecedence, syntax);
@@ -72,14 +87,36 @@ bool isHigherPrecedence(Node* left, Node* right) {
     return leftSyntax->rightPrecedence > rightSyntax->leftPrecedence;
 }
 
+static size_t hashSymbol(Lexeme lexeme) {
+    // interned lexemes with the same text have the same start
+    unsigned long long hash = (uintptr_t)lexeme.start ^ lexeme.length;
+    hash = (hash ^ (hash >> 17)) * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash >> 32) & (ENTRY_CAPACITY - 1);
+}
+
+static SyntaxEntry* findEntry(Lexeme lexeme) {
+    size_t i = hashSymbol(lexeme);
+    while (ENTRIES[i].lexeme.start != NULL &&
+            !isSameSymbol(ENTRIES[i].lexeme, lexeme))
+        i = (i + 1) & (ENTRY_CAPACITY - 1);
+    return &ENTRIES[i];
+}
+
+static void resizeEntries(size_t capacity) {
+    SyntaxEntry* entries = ENTRIES;
+    size_t oldCapacity = ENTRY_CAPACITY;
+    ENTRIES = (SyntaxEntry*)calloc(capacity, sizeof(SyntaxEntry));
+    if (ENTRIES == NULL)
+        error("\nError: out of memory\n");
+    ENTRY_CAPACITY = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i)
+        if (entries[i].lexeme.start != NULL)
+            *findEntry(entries[i].lexeme) = entries[i];
+    free(entries);
+}
+
 static Syntax* findSyntax(Lexeme lexeme) {
-    size_t n = length(SYNTAX);
-    for (unsigned int i = 1; i <= n; ++i) {
-        Syntax* syntax = elementAt(SYNTAX, n - i);
-        if (isSameLexeme(lexeme, syntax->lexeme))
-            return syntax;
-    }
-    return NULL;
+    return findEntry(internLexeme(lexeme))->syntax;
 }
 
 Node* parseOperator(Lexeme lexeme, long long subprecedence) {
@@ -89,20 +126,30 @@ Node* parseOperator(Lexeme lexeme, long long subprecedence) {
         (char)syntax->fixity), subprecedence, syntax);
 }
 
-static void appendSyntaxCopy(Syntax* syntax, Lexeme lexeme, Lexeme alias) {
-    Syntax* newSyntax = (Syntax*)smalloc(sizeof(Syntax));
-    *newSyntax = *syntax;
-    newSyntax->lexeme = lexeme;
-    newSyntax->alias = alias;
-    append(SYNTAX, newSyntax);
-}
-
 static void appendSyntax(Syntax syntax) {
-    Syntax* newSyntax = (Syntax*)smalloc(sizeof(Syntax));
+    if (2 * (ENTRY_COUNT + 1) > ENTRY_CAPACITY)
+        resizeEntries(2 * ENTRY_CAPACITY);
+    Syntax* newSyntax = (Syntax*)allocateSized(sizeof(Syntax));
     *newSyntax = syntax;
+    newSyntax->lexeme = internLexeme(syntax.lexeme);
+    SyntaxEntry* entry = findEntry(newSyntax->lexeme);
+    if (entry->lexeme.start == NULL) {
+        entry->lexeme = newSyntax->lexeme;
+        ENTRY_COUNT += 1;
+    }
+    newSyntax->shadowed = entry->syntax;
+    entry->syntax = newSyntax;
+    append(SCOPE, newSyntax);
     append(SYNTAX, newSyntax);
 }
 
+static void appendSyntaxCopy(Syntax* syntax, Lexeme lexeme, Lexeme alias) {
+    Syntax copy = *syntax;
+    copy.lexeme = lexeme;
+    copy.alias = alias;
+    appendSyntax(copy);
+}
+
 void addSyntax(Tag tag, Node* prior, Precedence precedence, Fixity fixity,
         Associativity associativity, Reducer reducer) {
     if (prior != NULL) {
@@ -120,18 +167,36 @@ void addSyntax(Tag tag, Node* prior, Precedence precedence, Fixity fixity,
     Lexeme lexeme = getLexeme(tag);
     Lexeme priorLexeme = prior ? getLexeme(getTag(prior)) : EMPTY;
     appendSyntax((Syntax){lexeme, lexeme, priorLexeme, '_', precedence,
-        precedence, fixity, associativity, special, reducer});
+        precedence, fixity, associativity, special, reducer, NULL});
 }
 
-void popSyntax(void) { unappend(SYNTAX); }
+void popSyntax(void) {
+    Syntax* syntax = unappend(SCOPE);
+    findEntry(syntax->lexeme)->syntax = syntax->shadowed;
+}
 
-void initSyntax(void) { SYNTAX = newArray(1024); }
+void initSyntax(void) {
+    SCOPE = newArray(1024);
+    SYNTAX = newArray(1024);
+    resizeEntries(1024);
+}
+
+void deleteSyntax(void) {
+    for (size_t i = 0; i < length(SYNTAX); ++i)
+        reclaimSized(elementAt(SYNTAX, i), sizeof(Syntax));
+    deleteArray(SCOPE);
+    deleteArray(SYNTAX);
+    free(ENTRIES);
+    SCOPE = SYNTAX = NULL;
+    ENTRIES = NULL;
+    ENTRY_COUNT = ENTRY_CAPACITY = 0;
+}
 
 void addCoreSyntax(const char* symbol, Precedence precedence,
         Fixity fixity, Associativity associativity, Reducer reducer) {
     Lexeme lexeme = newLiteralLexeme(symbol, newLocation(0, 0, 0));
     appendSyntax((Syntax){lexeme, lexeme, EMPTY, '_', precedence,
-        precedence, fixity, associativity, true, reducer});
+        precedence, fixity, associativity, true, reducer, NULL});
 }
 
 void addBracketSyntax(const char* symbol, char type, Precedence outerPrecedence,
@@ -141,7 +206,7 @@ void addBracketSyntax(const char* symbol, char type, Precedence outerPrecedence,
     Precedence leftPrecedence = fixity == OPENFIX ? outerPrecedence : 0;
     Precedence rightPrecedence = fixity == OPENFIX ? 0 : outerPrecedence;
     appendSyntax((Syntax){lexeme, lexeme, EMPTY, type,
-        leftPrecedence, rightPrecedence, fixity, R, true, reducer});
+        leftPrecedence, rightPrecedence, fixity, R, true, reducer, NULL});
 }
 
 void addCoreAlias(const char* alias, const char* name) {
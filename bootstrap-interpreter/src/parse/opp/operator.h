@@ -14,6 +14,7 @@ Node* reduceBracket(Node* open, Node* close, Node* before, Node* contents);
 Node* parseOperator(Lexeme lexeme, long long subprecedence);
 
 void initSyntax(void);
+void deleteSyntax(void);
 void addCoreSyntax(const char*, Precedence, Fixity, Associativity, Reducer);
 void addSyntax(Tag, Node* prior, Precedence, Fixity, Associativity, Reducer);
 void addBracketSyntax(const char*, char type, Precedence, Fixity, Reducer);
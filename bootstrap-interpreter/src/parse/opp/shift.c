@@ -75,7 +75,7 @@ static void reduceLeft(Stack* stack, Node* operator) {
                 isHigherPrecedence(peek(stack, 1), operator))
             lexeme = reduceTop(stack);
     Lexeme prior = getPrior(operator);
-    if (prior.length > 0 && !isSameLexeme(lexeme, prior))
+    if (prior.length > 0 && !isSameSymbol(lexeme, prior))
         syntaxErrorNode("invalid prior for", operator);
 }
 
@@ -12,6 +12,8 @@
 #include "bind.h"
 #include "parse.h"
 
+extern bool isIO;
+
 static Node* getTop(Stack* stack) {
     return isEmpty(stack) ? NULL : peek(stack, 0);
 }
@@ -85,29 +87,71 @@ static void shiftNode(Stack* stack, Node* node) {
     release(nodeHold);
 }
 
-static Hold* synthesize(Token (*lexer)(Token), Token start) {
-    initSymbols();
+static Hold* synthesize(Token (*lexer)(Token), Token start,
+        const Array* librarySyntax, Array* syntax) {
+    initSymbols(librarySyntax);
     Stack* stack = newStack();
     Node* startNode = parseToken(start);
     shiftNode(stack, startNode);
-    for (Token token = lexer(start); token.type != END; token = lexer(token))
+    for (Token token = lexer(start); token.type != END; token = lexer(token)) {
+        // the syntax in scope before the end of the input is closed is the
+        // syntax that code linked against this code is parsed with
+        if (token.lexeme.start[0] == '\0')
+            saveSymbols(syntax);
         if (token.type != COMMENT && token.type != VSPACE
                 && token.type != SPACE)
             shiftNode(stack, parseToken(token));
+    }
     Hold* ast = hold(getTop(stack));
     syntaxErrorNodeIf(ast == startNode, "no input", ast);
     deleteStack(stack);
+    clearSymbols();
     return ast;
 }
 
-Program parse(const char* input) {
-    Hold* result = synthesize(lex, newStartToken(input));
-    Array* globals = bind(result);
+static Hold* linkRoot(Program library, Hold* root) {
+    // the code takes the place of the entry of the library, which is the
+    // body of its last definition
+    size_t definitionCount = length(library.globals) - 1;
+    if (definitionCount == 0) {
+        release(library.root);
+        return root;
+    }
+    Node* node = library.root;
+    for (size_t i = 1; i < definitionCount; ++i)
+        node = getBody(getLeft(node));
+    setBody(getLeft(node), root);
+    release(root);
+    return library.root;
+}
+
+static void deleteSyntaxDefinitions(Array* syntax) {
+    for (size_t i = 0; i < length(syntax); ++i)
+        release(elementAt(syntax, i));
+    deleteArray(syntax);
+}
+
+Program parse(const char* input, Program library) {
+    // code is linked against a library by binding it in the scope of the
+    // definitions of the library, so the library is consumed
+    if (library.root != NULL)
+        isIO = false;   // until the code defines main
+    Array* syntax = newArray(64);
+    Hold* result = synthesize(lex, newStartToken(input), library.syntax,
+        syntax);
+    Array* globals = bind(result, library.root, library.globals);
     Term* entry = elementAt(globals, length(globals) - 1);
-    return (Program){result, entry, globals};
+    if (library.root == NULL)
+        return (Program){result, entry, globals, syntax};
+    Hold* root = linkRoot(library, result);
+    deleteArray(library.globals);
+    deleteSyntaxDefinitions(library.syntax);
+    return (Program){root, entry, globals, syntax};
 }
 
 void deleteProgram(Program program) {
     release(program.root);
     deleteArray(program.globals);
+    deleteSyntaxDefinitions(program.syntax);
+    deleteStrings();
 }
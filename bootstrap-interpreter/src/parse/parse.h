@@ -2,7 +2,8 @@ typedef struct {
     Hold* root;
     Term* entry;
     Array* globals;
+    Array* syntax;      // syntax definitions in scope at the end of the code
 } Program;
 
-Program parse(const char* input);
+Program parse(const char* input, Program library);
 void deleteProgram(Program program);
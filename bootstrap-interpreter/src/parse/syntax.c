@@ -1,4 +1,5 @@
 #include "tree.h"
+#include "array.h"
 #include "opp/operator.h"
 #include "ast.h"
 #include "patterns.h"
@@ -6,6 +7,17 @@
 #include "brackets.h"
 #include "syntax.h"
 
+// syntax definitions in scope, innermost last, which are saved in images so
+// that code linked against an image is parsed with the same syntax
+static Array* SYNTAX_DEFINITIONS = NULL;
+
+static Node* reduceDefinition(Tag tag, Node* left, Node* right) {
+    Node* definition = reduceDefine(tag, left, right);
+    if (isSyntaxDefinition(definition))
+        append(SYNTAX_DEFINITIONS, hold(definition));
+    return definition;
+}
+
 static Node* reduceArrow(Tag tag, Node* left, Node* right) {
     (void)tag;
     if (isKeyphrase(left, "case"))
@@ -57,8 +69,10 @@ static Node* reduceIfIs(Tag tag, Node* asPattern, Node* thenBlock) {
 static Node* reduceNewline(Tag tag, Node* left, Node* right) {
     // if left is a syntax definition then right is the scope of the definition
     // which has already been parsed, so the scope of the definition is over
-    if (isSyntaxDefinition(left))
+    if (isSyntaxDefinition(left)) {
         popSyntax();
+        release(unappend(SYNTAX_DEFINITIONS));
+    }
 
     if (isDefinition(left))
         return applyDefinition(left, right);
@@ -152,8 +166,9 @@ static Node* reduceReverseArrow(Tag tag, Node* left, Node* right) {
     return Definition(tag, BINDDEFINITION, left, right);
 }
 
-void initSymbols(void) {
+void initSymbols(const Array* syntax) {
     initSyntax();
+    SYNTAX_DEFINITIONS = newArray(64);
     addBracketSyntax("", '\0', 0, OPENFIX, reduceOpenFile);
     addBracketSyntax("\0", '\0', 0, CLOSEFIX, reduceRightIdentity);
     addBracketSyntax("(", '(', 95, OPENFIX, reduceOpenParenthesis);
@@ -168,7 +183,7 @@ void initSymbols(void) {
     addCoreSyntax(";", 2, INFIX, R, reduceNewline);
     addCoreSyntax("|", 3, INFIX, N, reduceReserved);
     addCoreSyntax(",", 4, INFIX, L, CommaPair);
-    addCoreSyntax(":=", 5, INFIX, R, reduceDefine);
+    addCoreSyntax(":=", 5, INFIX, R, reduceDefinition);
     addCoreSyntax("::=", 5, INFIX, N, reduceADTDefinition);
     addCoreSyntax("def", 5, PREFIX, N, reducePrefix);
     addCoreSyntax("sig", 5, PREFIX, N, reducePrefix);
@@ -201,4 +216,22 @@ void initSymbols(void) {
     addCoreAlias("\xE2\xA6\x8A", "|>"); // u298A
     addCoreAlias("\xE2\xA6\x89", "<|"); // u2989
     addCoreAlias("\xE2\x88\x80", "forall"); // u2200
+    for (size_t i = 0; syntax != NULL && i < length(syntax); ++i) {
+        Node* definition = elementAt(syntax, i);
+        reduceDefinition(getTag(definition), getLeft(definition),
+            getRight(definition));
+    }
+}
+
+void saveSymbols(Array* syntax) {
+    for (size_t i = 0; i < length(SYNTAX_DEFINITIONS); ++i)
+        append(syntax, hold(elementAt(SYNTAX_DEFINITIONS, i)));
+}
+
+void clearSymbols(void) {
+    while (length(SYNTAX_DEFINITIONS) > 0)
+        release(unappend(SYNTAX_DEFINITIONS));
+    deleteArray(SYNTAX_DEFINITIONS);
+    SYNTAX_DEFINITIONS = NULL;
+    deleteSyntax();
 }
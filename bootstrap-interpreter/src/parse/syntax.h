@@ -1 +1,3 @@
-void initSymbols(void);
+void initSymbols(const Array* syntax);
+void saveSymbols(Array* syntax);
+void clearSymbols(void);
@@ -1,4 +1,5 @@
-typedef enum {VARIABLE, ABSTRACTION, APPLICATION, NUMERAL, OPERATION} TermType;
+typedef enum {VARIABLE, ABSTRACTION, APPLICATION, NUMERAL, OPERATION,
+    PACKEDSTRING} TermType;
 
 // names in Operations must line up with codes in OperationCode
 static const char* const Operations[] = {"", "+", "--", "*", "//", "%",
@@ -19,6 +20,7 @@ static inline bool isAbstraction(Term* t) {return getType(t) == ABSTRACTION;}
 static inline bool isApplication(Term* t) {return getType(t) == APPLICATION;}
 static inline bool isNumeral(Term* t) {return getType(t) == NUMERAL;}
 static inline bool isOperation(Term* t) {return getType(t) == OPERATION;}
+static inline bool isPackedString(Term* t) {return getType(t) == PACKEDSTRING;}
 static inline bool isGlobal(Term* t) {return isVariable(t) && getValue(t) < 0;}
 static inline bool isValueType(TermType t) {
     return t == ABSTRACTION || t == NUMERAL;
@@ -41,6 +43,39 @@ static inline Term* Numeral(Tag tag, long long n) {
     return newLeaf(tag, NUMERAL, 0, n);
 }
 
+// numerals computed at runtime have no source location, so they don't need
+// a tag and small ones can be stored unboxed
+static inline Term* UntaggedNumeral(long long n) {
+    return newUntaggedLeaf(NUMERAL, n);
+}
+
+// with -DSHARE, terms built during evaluation share one node with the
+// identical terms built before them, as long as they are never modified.
+// parsed terms can't be shared since binding rewrites them in place
+static inline Term* SharedVariable(Tag tag, long long debruijn) {
+    return newSharedLeaf(tag, VARIABLE, 0, debruijn);
+}
+
+static inline Term* SharedAbstraction(Tag tag, Term* body) {
+    return newSharedBranch(tag, ABSTRACTION, 0, NULL, body);
+}
+
+static inline Term* SharedApplication(Tag tag, Term* left, Term* right) {
+    return newSharedBranch(tag, APPLICATION, 0, left, right);
+}
+
+static inline Term* SharedNumeral(long long n) {
+    return newSharedLeaf(NULL, NUMERAL, 0, n);
+}
+
+// a packed string is the list of its bytes, ((::) b rest) where rest is the
+// list of the remaining bytes, or [] after the last byte. it holds the
+// application ((::) []) of its constructors and a leaf with its bytes, which
+// are never empty and end with a null byte, until it is unpacked in place
+static inline char* getPackedBytes(Term* t) {return getData(getRight(t));}
+static inline Term* getPackedCons(Term* t) {return getLeft(getLeft(t));}
+static inline Term* getPackedNil(Term* t) {return getRight(getLeft(t));}
+
 // note: arithmetic operations are branches and always have a fallback term
 // but pseudo operations are leaves and don't have a fallback term
 static inline Term* Operation(Tag tag, OperationCode code, Term* term) {
@@ -2,13 +2,17 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include "util.h"
 #include "tree.h"
+#include "array.h"
 #include "lex/token.h"
 #include "opp/operator.h"
 #include "ast.h"
-#include "brackets.h"  // Nil and prepend
+#include "brackets.h"  // Nil, Cons and prepend
 #include "tokens.h"
 
+static Array* STRINGS = NULL;   // bytes of packed string literals
+
 static bool isNumberLexeme(Lexeme lexeme) {
     for (unsigned int i = 0; i < lexeme.length; ++i)
         if (!isdigit(lexeme.start[i]))
@@ -67,13 +71,50 @@ static Node* buildStringLiteral(Tag tag, const char* start) {
         buildStringLiteral(tag, skipQuoteCharacter(start)));
 }
 
+static char* packStringLiteral(Tag tag, const char* start) {
+    // returns the decoded bytes, or NULL if there are none or one of them is
+    // a null byte, since packed strings end with one
+    size_t length = 0;
+    const char* end = start;
+    for (; end[0] != getLexeme(tag).start[0]; end = skipQuoteCharacter(end)) {
+        syntaxErrorIf(end[0] == '\n' || end[0] == '\0',
+            "missing end quote for", tag);
+        if (decodeCharacter(end, tag) == '\0')
+            return NULL;
+        length += 1;
+    }
+    if (length == 0)
+        return NULL;
+    char* bytes = (char*)smalloc(length + 1);
+    length = 0;
+    for (const char* p = start; p < end; p = skipQuoteCharacter(p))
+        bytes[length++] = (char)decodeCharacter(p, tag);
+    bytes[length] = '\0';
+    if (STRINGS == NULL)
+        STRINGS = newArray(1024);
+    append(STRINGS, bytes);
+    return bytes;
+}
+
 static Node* parseStringLiteral(Lexeme lexeme) {
     Hold* name = hold(Name(newTag(lexeme, NOFIX)));
-    Node* node = buildStringLiteral(getTag(name), lexeme.start + 1);
+    Tag tag = getTag(name);
+    char* bytes = packStringLiteral(tag, lexeme.start + 1);
+    Node* node = bytes == NULL ? buildStringLiteral(tag, lexeme.start + 1) :
+        StringLiteral(tag, Juxtaposition(tag, Cons(tag), Nil(tag)), bytes);
     release(name);
     return node;
 }
 
+void deleteStrings(void) {
+    if (STRINGS == NULL)
+        return;
+    for (size_t i = 0; i < length(STRINGS); ++i)
+        free(elementAt(STRINGS, i));
+    deleteArray(STRINGS);
+    STRINGS = NULL;
+}
+
 Node* parseSymbol(Lexeme lexeme, long long subprecedence) {
     Node* operator = parseOperator(lexeme, subprecedence);
     return operator == NULL ? Name(newTag(lexeme, NOFIX)) : operator;
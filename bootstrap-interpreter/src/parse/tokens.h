@@ -1,2 +1,3 @@
 Node* parseSymbol(Lexeme lexeme, long long subprecedence);
 Node* parseToken(Token token);
+void deleteStrings(void);
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include "util.h"
+#include "tree.h"
+#include "spine.h"
+
+// the spine is a contiguous stack of frames used by the evaluator; an
+// operation that is waiting for its operands is kept in a continuation frame
+// on top of two operand frames, so the evaluator can evaluate the operands in
+// its own loop instead of recursing on the C stack
+
+typedef enum {ARGUMENT, UPDATE, OPERAND, CONTINUATION} FrameType;
+
+typedef struct {
+    Node* node;
+    FrameType type;
+} Frame;
+
+struct Spine {
+    size_t capacity, height;
+    Frame* frames;
+};
+
+Spine* newSpine(size_t initialCapacity) {
+    Spine* spine = (Spine*)smalloc(sizeof(Spine));
+    spine->capacity = initialCapacity;
+    spine->height = 0;
+    spine->frames = (Frame*)smalloc(initialCapacity * sizeof(Frame));
+    return spine;
+}
+
+void deleteSpine(Spine* spine) {
+    while (spine->height > 0)
+        release(spine->frames[--spine->height].node);
+    free(spine->frames);
+    free(spine);
+}
+
+bool isSpineEmpty(const Spine* spine) {return spine->height == 0;}
+
+static void pushFrame(Spine* spine, Node* node, FrameType type) {
+    if (spine->height == spine->capacity) {
+        spine->capacity = spine->capacity == 0 ? 1 : 2 * spine->capacity;
+        size_t newSize = spine->capacity * sizeof(Frame);
+        spine->frames = (Frame*)realloc(spine->frames, newSize);
+        if (spine->frames == NULL)
+            error("\nError: out of memory\n");
+    }
+    spine->frames[spine->height++] = (Frame){hold(node), type};
+}
+
+void pushArgument(Spine* spine, Node* node) {pushFrame(spine, node, ARGUMENT);}
+void pushUpdate(Spine* spine, Node* node) {pushFrame(spine, node, UPDATE);}
+
+void pushOperand(Spine* spine, Node* node) {pushFrame(spine, node, OPERAND);}
+
+void pushContinuation(Spine* spine, Node* node) {
+    pushFrame(spine, node, CONTINUATION);
+}
+
+Hold* popFrame(Spine* spine) {
+    assert(!isSpineEmpty(spine));
+    return spine->frames[--spine->height].node;
+}
+
+Node* peekFrame(const Spine* spine, size_t i) {
+    assert(i < spine->height);
+    return spine->frames[spine->height - i - 1].node;
+}
+
+static bool isFrameType(const Spine* spine, size_t i, FrameType type) {
+    return i < spine->height &&
+        spine->frames[spine->height - i - 1].type == type;
+}
+
+bool isUpdateFrame(const Spine* spine, size_t i) {
+    return isFrameType(spine, i, UPDATE);
+}
+
+bool isContinuationFrame(const Spine* spine, size_t i) {
+    return isFrameType(spine, i, CONTINUATION);
+}
+
+bool hasArguments(const Spine* spine, size_t n) {
+    // true if the top n frames are all arguments
+    for (size_t i = 0; i < n; ++i)
+        if (!isFrameType(spine, i, ARGUMENT))
+            return false;
+    return true;
+}
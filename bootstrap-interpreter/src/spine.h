@@ -0,0 +1,14 @@
+typedef struct Spine Spine;
+
+Spine* newSpine(size_t initialCapacity);
+void deleteSpine(Spine* spine);
+bool isSpineEmpty(const Spine* spine);
+void pushArgument(Spine* spine, Node* node);
+void pushUpdate(Spine* spine, Node* node);
+void pushOperand(Spine* spine, Node* node);
+void pushContinuation(Spine* spine, Node* node);
+Hold* popFrame(Spine* spine);
+Node* peekFrame(const Spine* spine, size_t i);
+bool isUpdateFrame(const Spine* spine, size_t i);
+bool isContinuationFrame(const Spine* spine, size_t i);
+bool hasArguments(const Spine* spine, size_t n);
@@ -9,13 +9,34 @@ DIR=$(dirname "$0")
 LIB="$DIR/../../libraries"
 CMD="$DIR/../main"
 
+META=0
 if test "$#" -gt 0 && test "$1" = "meta"; then
     META=1
     CMD="$DIR/../../self-interpreter/main"
-else
-    META=0
+elif test "$#" -gt 0 && test "$1" = "walk"; then
+    # evaluate by walking the term tree for differential testing of bytecode
+    CMD="$CMD -w"
+elif test "$#" -gt 0 && test "$1" = "image"; then
+    # save each program as an image and run it from the image
+    IMAGE=$(mktemp)
+    trap 'rm -f "$IMAGE"' EXIT
+    CMD="run_image"
+elif test "$#" -gt 0 && test "$1" = "link"; then
+    # link each test against an image of its prelude instead of parsing both
+    LINK=1
+    IMAGE=$(mktemp)
+    trap 'rm -f "$IMAGE"' EXIT
+    CMD="run_linked"
 fi
 
+run_image() {
+    "$DIR/../main" -o "$IMAGE" && "$DIR/../main" -i "$IMAGE"
+}
+
+run_linked() {
+    "$DIR/../main" -i "$IMAGE" /dev/stdin
+}
+
 header() {
     printf "%b\n" "${BLUE}========== $1 ==========${NOCOLOR}"
 }
@@ -51,6 +72,11 @@ oneline_suite() {
     for filename in "$@"; do
         prelude=$(printf "%s\n%s" "$prelude" "$(cat "$filename")")
     done
+    if [ "${LINK-0}" -eq 1 ]; then
+        # an image needs an entry, which linking replaces with the test
+        printf "%s\n0\n" "$prelude" | sed '/./,$!d' | "$DIR/../main" -o "$IMAGE"
+        prelude=""
+    fi
     header "$name"
     while IFS='' read -r line; do
         read -r output_line
@@ -84,7 +110,7 @@ summarize() {
 
 SUITES="tokens.test quote.test brackets.test lambda.test syntax.test adt.test"
 PRELUDE="$LIB/operators.zero $LIB/prelude.zero $DIR/include.zero"
-PRELUDE_SUITES="arithmetic.test definition.test sections.test tuples.test math.test prelude.test show.test infinite.test"
+PRELUDE_SUITES="arithmetic.test definition.test sections.test tuples.test math.test prelude.test show.test infinite.test sharing.test immediates.test"
 META_PRELUDE_SUITES="arithmetic.test definition.test sections.test tuples.test math.test prelude.test"
 
 run() {